@@ -0,0 +1,21 @@
+#!/bin/bash
+# Times every script in benchmarks/ on both execution engines.
+# Usage: scripts/benchmark.sh [path/to/AlengCLI]
+
+cd "$(dirname "$0")/.."
+
+CLI=${1:-./build/AlengCLI}
+
+if [ ! -x "$CLI" ]; then
+  echo "AlengCLI not found at $CLI, build the project first or pass its path."
+  exit 1
+fi
+
+for bench in benchmarks/*.aleng; do
+  for mode in "" "--tree-walk"; do
+    start=$(date +%s.%N)
+    "$CLI" $mode "$bench" > /dev/null
+    end=$(date +%s.%N)
+    printf "%-28s %-12s %8.3fs\n" "$(basename "$bench")" "${mode:-bytecode}" "$(awk "BEGIN { print $end - $start }")"
+  done
+done
@@ -47,6 +47,7 @@ def main():
         "// DO NOT EDIT MANUALLY\n",
         "#pragma once",
         "#include <string>",
+        "#include <string_view>",
         "#include <unordered_map>\n",
         "namespace Aleng::StdLib",
         "{",
@@ -55,13 +56,13 @@ def main():
     # 1. Define all source strings as C++ raw string literals
     for lib in libraries:
         header_content.append(f"    // Source from {lib['source_path'].as_posix()}")
-        header_content.append(f'    const char* {lib["cpp_var"]} = R"ALENG_STDLIB({lib["content"]})ALENG_STDLIB";\n')
+        header_content.append(f'    inline constexpr std::string_view {lib["cpp_var"]} = R"ALENG_STDLIB({lib["content"]})ALENG_STDLIB";\n')
 
     header_content.extend([
-        "    // Function to register all standard libraries",
-        "    inline std::unordered_map<std::string, std::string> GetLibraries()",
+        "    // Sources of all standard libraries, keyed by module name. ModuleManager parses them on first import.",
+        "    inline std::unordered_map<std::string, std::string_view> GetLibraries()",
         "    {",
-        "        std::unordered_map<std::string, std::string> libs;",
+        "        std::unordered_map<std::string, std::string_view> libs;",
     ])
 
     if not libraries:
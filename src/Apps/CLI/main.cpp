@@ -1,11 +1,11 @@
 #include <iostream>
 
 #include "../../Core/Visitor.h"
+#include "../../Core/AstCache.h"
 #include "../../Core/Parser.h"
 #include "../../Core/Error.h"
 
 #include <filesystem>
-#include <fstream>
 #include <sstream>
 
 #include "../../Core/ModuleManager.h"
@@ -39,12 +39,22 @@ void RunREPL(Visitor &visitor)
             auto parser = Parser(ss.str(), "REPL");
             auto ast = parser.ParseProgram();
 
-            auto result = ast->Accept(visitor);
+            if (parser.HasErrors())
+            {
+                for (const auto &err : parser.GetErrors())
+                    PrintFormattedError(err);
+                continue;
+            }
+
+            auto result = visitor.Execute(std::move(ast));
         }
         catch (const AlengError &err)
         {
-            std::string sourceCode = ss.str();
-            PrintFormattedError(err, sourceCode);
+            PrintFormattedError(err);
+        }
+        catch (const ExecutionInterrupted &err)
+        {
+            PrintFormattedError(err);
         }
         catch (const std::runtime_error &err)
         {
@@ -53,27 +63,75 @@ void RunREPL(Visitor &visitor)
     }
 }
 
+// Writes a .alengc cache next to every script in the workspace. Returns the process exit code.
+int CompileWorkspace(const fs::path &workspacePath)
+{
+    int failed = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(workspacePath))
+    {
+        if (!entry.is_regular_file() || entry.path().extension() != ".aleng")
+            continue;
+
+        std::vector<AlengError> errors;
+        if (!AstCache::Compile(entry.path().string(), errors))
+        {
+            for (const auto &err : errors)
+                PrintFormattedError(err);
+            if (errors.empty())
+                std::cerr << "Error: could not compile " << entry.path().string() << std::endl;
+            failed++;
+        }
+    }
+
+    return failed == 0 ? 0 : 1;
+}
+
 int main(int argc, char *argv[])
 {
     fs::path workspacePath;
     std::string mainFilename = "main.aleng";
     fs::path resolvedMainFilePath;
 
-    auto replModuleManager = ModuleManager(fs::current_path());
-    RegisterAllNativeLibraries(replModuleManager);
-    auto replVisitor = Visitor(replModuleManager);
+    auto executionMode = ExecutionMode::BYTECODE;
+    bool runRepl = false;
+    bool compileOnly = false;
+    size_t memoryLimit = 0;
+    uint64_t stepBudget = 0;
+    std::string pathArgument;
 
-    if (argc >= 2)
+    for (int i = 1; i < argc; i++)
     {
-        std::string argument = argv[1];
+        std::string argument = argv[i];
+
+        if (argument == "--repl")
+            runRepl = true;
+        else if (argument == "--tree-walk")
+            executionMode = ExecutionMode::TREE_WALK;
+        else if (argument == "--compile")
+            compileOnly = true;
+        else if (argument == "--memory-limit" && i + 1 < argc)
+            memoryLimit = std::stoull(argv[++i]);
+        else if (argument == "--step-budget" && i + 1 < argc)
+            stepBudget = std::stoull(argv[++i]);
+        else if (pathArgument.empty())
+            pathArgument = argument;
+    }
 
-        if (argument.starts_with("--") && argument == "--repl")
-        {
-            RunREPL(replVisitor);
-            return 0;
-        }
+    if (runRepl)
+    {
+        auto replModuleManager = ModuleManager(fs::current_path());
+        RegisterAllNativeLibraries(replModuleManager);
+        auto replVisitor = Visitor(replModuleManager, executionMode);
+        replVisitor.SetMemoryLimit(memoryLimit);
+        replVisitor.SetStepBudget(stepBudget);
+
+        RunREPL(replVisitor);
+        return 0;
+    }
 
-        if (fs::path targetPath(argument); fs::is_directory(targetPath))
+    if (!pathArgument.empty())
+    {
+        if (fs::path targetPath(pathArgument); fs::is_directory(targetPath))
         {
             workspacePath = targetPath;
             if (!fs::exists(workspacePath / mainFilename))
@@ -81,14 +139,17 @@ int main(int argc, char *argv[])
                 std::cerr << "Error: " << mainFilename << " not found in " << workspacePath << std::endl;
                 return 1;
             }
+            resolvedMainFilePath = fs::absolute(workspacePath / mainFilename);
         }
         else if (fs::is_regular_file(targetPath))
         {
-            workspacePath = targetPath.parent_path();
+            resolvedMainFilePath = fs::absolute(targetPath);
+            workspacePath = resolvedMainFilePath.parent_path();
         }
         else
         {
-            std::cerr << "Error: invalid path " << argument << std::endl;
+            std::cerr << "Error: invalid path " << pathArgument << std::endl;
+            return 1;
         }
     }
     else
@@ -129,10 +190,15 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (compileOnly)
+        return CompileWorkspace(workspacePath);
+
     auto moduleManager = ModuleManager(workspacePath);
     RegisterAllNativeLibraries(moduleManager);
 
-    Visitor visitor(moduleManager);
+    Visitor visitor(moduleManager, executionMode);
+    visitor.SetMemoryLimit(memoryLimit);
+    visitor.SetStepBudget(stepBudget);
 
     try
     {
@@ -148,19 +214,12 @@ int main(int argc, char *argv[])
     }
     catch (const AlengError &err)
     {
-        std::string sourceCode;
-
-        if (std::string filepath = err.GetRange().FilePath; !filepath.empty() && filepath != "REPL")
-        {
-            if (std::ifstream file(filepath); file)
-            {
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                sourceCode = buffer.str();
-            }
-        }
-
-        PrintFormattedError(err, sourceCode);
+        PrintFormattedError(err);
+    }
+    catch (const ExecutionInterrupted &err)
+    {
+        PrintFormattedError(err);
+        return 1;
     }
     catch (const std::runtime_error &err)
     {
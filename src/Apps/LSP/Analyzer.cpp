@@ -86,20 +86,27 @@ namespace AlengLSP
     void Analyzer::VisitNode(const Aleng::ASTNode* node, std::shared_ptr<Scope>& currentScope, FileAnalysisContext& ctx) {
         if (!node) return;
 
-        if (const auto strNode = dynamic_cast<const Aleng::StringNode*>(node)) {
+        switch (node->Kind) {
+        case Aleng::NodeKind::STRING: {
+            const auto strNode = static_cast<const Aleng::StringNode*>(node);
             if (strNode->Location.Start.Line == strNode->Location.End.Line) {
                 auto loc = strNode->Location;
                 loc.End.Column -= 1;
                 AddSpatialToken(loc, SemanticType::String, ctx);
             }
+            break;
         }
-        else if (dynamic_cast<const Aleng::IntegerNode*>(node) || dynamic_cast<const Aleng::FloatNode*>(node)) {
+        case Aleng::NodeKind::INTEGER:
+        case Aleng::NodeKind::FLOAT: {
             AddSpatialToken(node->Location, SemanticType::Number, ctx);
+            break;
         }
-        else if (dynamic_cast<const Aleng::BooleanNode*>(node)) {
+        case Aleng::NodeKind::BOOLEAN: {
             AddSpatialToken(node->Location, SemanticType::Keyword, ctx);
+            break;
         }
-        else if (const auto id = dynamic_cast<const Aleng::IdentifierNode*>(node)) {
+        case Aleng::NodeKind::IDENTIFIER: {
+            const auto id = static_cast<const Aleng::IdentifierNode*>(node);
             auto sym = currentScope->Resolve(id->Value);
             if (sym) {
                 sym->AddReference(id->Location);
@@ -107,10 +114,10 @@ namespace AlengLSP
             } else {
                 AddSpatialToken(id->Location, SemanticType::Variable, ctx);
             }
+            break;
         }
-
-
-        else if (const auto forNode = dynamic_cast<const Aleng::ForStatementNode*>(node)) {
+        case Aleng::NodeKind::FOR_STATEMENT: {
+            const auto forNode = static_cast<const Aleng::ForStatementNode*>(node);
             AddSpatialToken(forNode->Location, SemanticType::Keyword, ctx);
 
             auto loopScope = std::make_shared<Scope>(currentScope);
@@ -143,9 +150,10 @@ namespace AlengLSP
             AddSpatialToken(endKwRange, SemanticType::Keyword, ctx);
 
             currentScope = prevScope;
+            break;
         }
-
-        else if (const auto whileNode = dynamic_cast<const Aleng::WhileStatementNode*>(node)) {
+        case Aleng::NodeKind::WHILE_STATEMENT: {
+            const auto whileNode = static_cast<const Aleng::WhileStatementNode*>(node);
             AddSpatialToken(whileNode->Location, SemanticType::Keyword, ctx);
 
             VisitNode(whileNode->Condition.get(), currentScope, ctx);
@@ -157,9 +165,10 @@ namespace AlengLSP
             endKwRange.End.Column = whileNode->Location.End.Column;
             endKwRange.Start.Column = std::max(1, endKwRange.End.Column - 2);
             AddSpatialToken(endKwRange, SemanticType::Keyword, ctx);
+            break;
         }
-
-        else if (const auto ifNode = dynamic_cast<const Aleng::IfNode*>(node)) {
+        case Aleng::NodeKind::IF: {
+            const auto ifNode = static_cast<const Aleng::IfNode*>(node);
             Aleng::SourceRange kwRange = ifNode->Location;
             kwRange.End.Line = kwRange.Start.Line;
             kwRange.End.Column = kwRange.Start.Column + 1;
@@ -177,10 +186,10 @@ namespace AlengLSP
             endKwRange.End.Column = ifNode->Location.End.Column;
             endKwRange.Start.Column = std::max(1, endKwRange.End.Column - 2);
             AddSpatialToken(endKwRange, SemanticType::Keyword, ctx);
+            break;
         }
-
-        else if (const auto func = dynamic_cast<const Aleng::FunctionDefinitionNode*>(node))
-        {
+        case Aleng::NodeKind::FUNCTION_DEFINITION: {
+            const auto func = static_cast<const Aleng::FunctionDefinitionNode*>(node);
             auto fnKeywordRange = Aleng::SourceRange(
                 func->Location.Start,
                 Aleng::SourceLocation(
@@ -232,31 +241,41 @@ namespace AlengLSP
             AddSpatialToken(endKwRange, SemanticType::Keyword, ctx);
 
             currentScope = prevScope;
+            break;
         }
-
-        else if (const auto ret = dynamic_cast<const Aleng::ReturnNode*>(node)) {
+        case Aleng::NodeKind::RETURN: {
+            const auto ret = static_cast<const Aleng::ReturnNode*>(node);
             AddSpatialToken(ret->Location, SemanticType::Keyword, ctx);
             if (ret->ReturnValueExpression) VisitNode(ret->ReturnValueExpression.get(), currentScope, ctx);
+            break;
         }
-        else if (const auto brk = dynamic_cast<const Aleng::BreakNode*>(node)) {
+        case Aleng::NodeKind::BREAK: {
+            const auto brk = static_cast<const Aleng::BreakNode*>(node);
             AddSpatialToken(brk->Location, SemanticType::Keyword, ctx);
+            break;
         }
-        else if (const auto cont = dynamic_cast<const Aleng::ContinueNode*>(node)) {
+        case Aleng::NodeKind::CONTINUE: {
+            const auto cont = static_cast<const Aleng::ContinueNode*>(node);
             AddSpatialToken(cont->Location, SemanticType::Keyword, ctx);
+            break;
         }
-        else if (const auto imp = dynamic_cast<const Aleng::ImportModuleNode*>(node)) {
+        case Aleng::NodeKind::IMPORT_MODULE: {
+            const auto imp = static_cast<const Aleng::ImportModuleNode*>(node);
             AddSpatialToken(imp->Location, SemanticType::Keyword, ctx);
             AddSpatialToken(imp->ModuleLocation, SemanticType::String, ctx);
+            break;
         }
-
-        else if (const auto block = dynamic_cast<const Aleng::BlockNode*>(node)) {
+        case Aleng::NodeKind::BLOCK: {
+            const auto block = static_cast<const Aleng::BlockNode*>(node);
             for (const auto& stmt : block->Statements) VisitNode(stmt.get(), currentScope, ctx);
+            break;
         }
-        else if (const auto assign = dynamic_cast<const Aleng::AssignExpressionNode*>(node)) {
+        case Aleng::NodeKind::ASSIGN_EXPRESSION: {
+            const auto assign = static_cast<const Aleng::AssignExpressionNode*>(node);
             VisitNode(assign->Right.get(), currentScope, ctx);
             auto rhsType = InferType(assign->Right.get(), currentScope);
 
-            if (const auto ident = dynamic_cast<const Aleng::IdentifierNode*>(assign->Left.get()))
+            if (const auto ident = Aleng::NodeCast<Aleng::IdentifierNode>(assign->Left.get()))
             {
                 if (auto existing = currentScope->Resolve(ident->Value))
                 {
@@ -267,44 +286,62 @@ namespace AlengLSP
                     DefineSymbol(ident->Value, Symbol::Category::Variable, rhsType, ident->Location, currentScope, ctx);
                 }
             }
-            else if (const auto member = dynamic_cast<const Aleng::MemberAccessNode*>(assign->Left.get())) {
+            else if (const auto member = Aleng::NodeCast<Aleng::MemberAccessNode>(assign->Left.get())) {
                 VisitNode(member, currentScope, ctx);
             }
-            else if (const auto listAcc = dynamic_cast<const Aleng::ListAccessNode*>(assign->Left.get())) {
+            else if (const auto listAcc = Aleng::NodeCast<Aleng::ListAccessNode>(assign->Left.get())) {
                 VisitNode(listAcc, currentScope, ctx);
             }
+            break;
         }
-        else if (const auto call = dynamic_cast<const Aleng::FunctionCallNode*>(node)) {
+        case Aleng::NodeKind::FUNCTION_CALL: {
+            const auto call = static_cast<const Aleng::FunctionCallNode*>(node);
             VisitNode(call->CallableExpression.get(), currentScope, ctx);
             for (const auto& arg : call->Arguments) VisitNode(arg.get(), currentScope, ctx);
+            break;
         }
-        else if (const auto bin = dynamic_cast<const Aleng::BinaryExpressionNode*>(node)) {
+        case Aleng::NodeKind::BINARY_EXPRESSION: {
+            const auto bin = static_cast<const Aleng::BinaryExpressionNode*>(node);
             VisitNode(bin->Left.get(), currentScope, ctx);
             VisitNode(bin->Right.get(), currentScope, ctx);
+            break;
         }
-        else if (const auto un = dynamic_cast<const Aleng::UnaryExpressionNode*>(node)) {
+        case Aleng::NodeKind::UNARY_EXPRESSION: {
+            const auto un = static_cast<const Aleng::UnaryExpressionNode*>(node);
             VisitNode(un->Right.get(), currentScope, ctx);
+            break;
         }
-        else if (const auto list = dynamic_cast<const Aleng::ListNode*>(node)) {
+        case Aleng::NodeKind::LIST: {
+            const auto list = static_cast<const Aleng::ListNode*>(node);
             for(const auto& el : list->Elements) VisitNode(el.get(), currentScope, ctx);
+            break;
         }
-        else if (const auto map = dynamic_cast<const Aleng::MapNode*>(node)) {
+        case Aleng::NodeKind::MAP: {
+            const auto map = static_cast<const Aleng::MapNode*>(node);
             for(const auto&[key, val] : map->Elements) {
                 VisitNode(key.get(), currentScope, ctx);
                 VisitNode(val.get(), currentScope, ctx);
             }
+            break;
         }
-        else if (const auto member = dynamic_cast<const Aleng::MemberAccessNode*>(node)) {
+        case Aleng::NodeKind::MEMBER_ACCESS: {
+            const auto member = static_cast<const Aleng::MemberAccessNode*>(node);
             VisitNode(member->Object.get(), currentScope, ctx);
             Aleng::SourceRange propRange = member->Location;
-            propRange.Start.Column = propRange.End.Column - member->MemberIdentifier.Value.length() + 1;
+            propRange.Start.Column = propRange.End.Column - member->MemberName.length() + 1;
             if (propRange.Start.Column > member->Location.Start.Column) {
                  AddSpatialToken(propRange, SemanticType::Property, ctx);
             }
+            break;
         }
-        else if (const auto listAcc = dynamic_cast<const Aleng::ListAccessNode*>(node)) {
+        case Aleng::NodeKind::LIST_ACCESS: {
+            const auto listAcc = static_cast<const Aleng::ListAccessNode*>(node);
             VisitNode(listAcc->Object.get(), currentScope, ctx);
             VisitNode(listAcc->Index.get(), currentScope, ctx);
+            break;
+        }
+        default:
+            break;
         }
     }
 
@@ -312,15 +349,21 @@ namespace AlengLSP
     {
         if (!node) return std::make_shared<TypeInfo>();
 
-        if (dynamic_cast<const Aleng::IntegerNode *>(node) || dynamic_cast<const Aleng::FloatNode *>(node))
-            return std::make_shared<TypeInfo>(TypeInfo{TypeInfo::Kind::Number});
-
-        if (dynamic_cast<const Aleng::StringNode *>(node))
-            return std::make_shared<TypeInfo>(TypeInfo{TypeInfo::Kind::String});
-
-        if (const auto id = dynamic_cast<const Aleng::IdentifierNode *>(node))
+        switch (node->Kind)
         {
-            if (const auto sym = scope->Resolve(id->Value); sym && sym->type) return sym->type;
+            case Aleng::NodeKind::INTEGER:
+            case Aleng::NodeKind::FLOAT:
+                return std::make_shared<TypeInfo>(TypeInfo{TypeInfo::Kind::Number});
+            case Aleng::NodeKind::STRING:
+                return std::make_shared<TypeInfo>(TypeInfo{TypeInfo::Kind::String});
+            case Aleng::NodeKind::IDENTIFIER:
+            {
+                const auto id = static_cast<const Aleng::IdentifierNode *>(node);
+                if (const auto sym = scope->Resolve(id->Value); sym && sym->type) return sym->type;
+                break;
+            }
+            default:
+                break;
         }
 
         // TODO: BinaryExpression inference, FunctionCall return type inference
@@ -24,10 +24,10 @@ using json = nlohmann::json;
 class AlengWasmInterface {
 public:
     AlengWasmInterface()
-        : m_ModuleManager(std::make_unique<ModuleManager>("/virtual_fs")),
-          m_Visitor(std::make_unique<Visitor>(*m_ModuleManager))
+        : m_BaseModuleManager(std::make_unique<ModuleManager>("/virtual_fs")),
+          m_BaseVisitor(std::make_unique<Visitor>(*m_BaseModuleManager))
     {
-        RegisterAllNativeLibraries(*m_ModuleManager);
+        RegisterAllNativeLibraries(*m_BaseModuleManager);
     }
 
     std::string Execute(std::string sourceCode) {
@@ -35,11 +35,24 @@ public:
             Parser parser(sourceCode, "playground.aleng");
             auto program = parser.ParseProgram();
 
-            m_ModuleManager = std::make_unique<ModuleManager>("/virtual_fs");
-            RegisterAllNativeLibraries(*m_ModuleManager);
-            m_Visitor = std::make_unique<Visitor>(*m_ModuleManager);
+            // A program that failed to parse is not run; report every syntax error instead.
+            if (parser.HasErrors()) {
+                std::stringstream ss;
+                for (const auto& err : parser.GetErrors()) {
+                    auto loc = err.GetRange();
+                    ss << "Syntax Error: " << err.what() << "\n";
+                    ss << "  at line " << loc.Start.Line << ", col " << loc.Start.Column << "\n";
+                }
+                return ss.str();
+            }
+
+            // Every run starts from a fork of the initialized engine instead of rebuilding it.
+            m_Visitor.reset();
+            m_ModuleManager = std::make_unique<ModuleManager>(m_BaseModuleManager->Fork());
+            m_Visitor = m_BaseVisitor->Fork(*m_ModuleManager);
+            m_Visitor->SetStepBudget(m_StepBudget);
 
-            auto result = program->Accept(*m_Visitor);
+            auto result = m_Visitor->Execute(std::move(program));
             return "";
         }
         catch (const AlengError& e) {
@@ -49,11 +62,37 @@ public:
             ss << "  at line " << loc.Start.Line << ", col " << loc.Start.Column;
             return ss.str();
         }
+        catch (const ExecutionInterrupted& e) {
+            std::stringstream ss;
+            auto loc = e.GetRange();
+            ss << "Stopped: " << e.what() << "\n";
+            ss << "  at line " << loc.Start.Line << ", col " << loc.Start.Column;
+            return ss.str();
+        }
         catch (const std::exception& e) {
             return std::string("Fatal Error: ") + e.what();
         }
     }
 
+    // Applies to every later run; 0 removes the limit.
+    void SetMemoryLimit(const double bytes)
+    {
+        m_BaseVisitor->SetMemoryLimit(static_cast<size_t>(bytes));
+    }
+
+    // Steps each later run may take, so a runaway loop cannot freeze the page; 0 removes the budget.
+    void SetStepBudget(const double steps)
+    {
+        m_StepBudget = static_cast<uint64_t>(steps);
+    }
+
+    // Usage of the last run, as {"current", "peak", "limit"} in bytes.
+    [[nodiscard]] std::string GetMemoryUsage() const
+    {
+        const auto usage = m_Visitor ? m_Visitor->GetMemoryUsage() : m_BaseVisitor->GetMemoryUsage();
+        return json{{"current", usage.Current}, {"peak", usage.Peak}, {"limit", usage.Limit}}.dump();
+    }
+
     std::string Lint(const std::string &sourceCode)
     {
         json diagnostics = json::array();
@@ -187,7 +226,7 @@ public:
             {"insertTextRules", 4}
         });
 
-        std::vector<std::string> builtins = {"Print", "Append", "Len", "Pop", "ToNumber"};
+        std::vector<std::string> builtins = {"Print", "Append", "Len", "Pop", "ToNumber", "Join"};
         for(const auto& b : builtins) {
              items.push_back({
                 {"label", b},
@@ -220,8 +259,12 @@ public:
     }
 
 private:
+    std::unique_ptr<ModuleManager> m_BaseModuleManager;
+    std::unique_ptr<Visitor> m_BaseVisitor;
+
     std::unique_ptr<ModuleManager> m_ModuleManager;
     std::unique_ptr<Visitor> m_Visitor;
+    uint64_t m_StepBudget = 0;
 
     Analyzer m_Analyzer;
 };
@@ -231,6 +274,9 @@ EMSCRIPTEN_BINDINGS(aleng_module)
     class_<AlengWasmInterface>("Aleng")
         .constructor<>()
         .function("execute", &AlengWasmInterface::Execute)
+        .function("setMemoryLimit", &AlengWasmInterface::SetMemoryLimit)
+        .function("getMemoryUsage", &AlengWasmInterface::GetMemoryUsage)
+        .function("setStepBudget", &AlengWasmInterface::SetStepBudget)
         .function("lint", &AlengWasmInterface::Lint)
         .function("complete", &AlengWasmInterface::Complete)
         .function("getHover", &AlengWasmInterface::GetHover)
@@ -1,53 +1,125 @@
 #include "AST.h"
 
+#include <algorithm>
 #include <iostream>
+#include <new>
 
 #include "Visitor.h"
 
 namespace Aleng
 {
+    namespace
+    {
+        thread_local NodeArena *t_ActiveArena = nullptr;
+
+        // Each node is preceded by the arena it lives in, or null when it was heap allocated.
+        constexpr size_t NODE_HEADER = alignof(std::max_align_t);
+
+        // Node allocation and release both go through these two, so the header and the heap fallback's
+        // new[]/delete[] pair stay in one place.
+        void *AllocateNode(const size_t size)
+        {
+            std::byte *block = t_ActiveArena
+                ? static_cast<std::byte *>(t_ActiveArena->Allocate(NODE_HEADER + size))
+                : new std::byte[NODE_HEADER + size];
+            new (block) NodeArena *(t_ActiveArena);
+            return block + NODE_HEADER;
+        }
+
+        void FreeNode(void *node)
+        {
+            if (!node)
+                return;
+            std::byte *block = static_cast<std::byte *>(node) - NODE_HEADER;
+            if (!*std::launder(reinterpret_cast<NodeArena **>(block)))
+                delete[] block;
+        }
+    }
+
+    void *NodeArena::Allocate(size_t size)
+    {
+        size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        if (size > m_Remaining)
+        {
+            const size_t blockSize = std::max(size, BLOCK_SIZE);
+            m_Blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(blockSize));
+            m_Next = m_Blocks.back().get();
+            m_Remaining = blockSize;
+        }
+
+        void *memory = m_Next;
+        m_Next += size;
+        m_Remaining -= size;
+        return memory;
+    }
+
+    NodeArena::Scope::Scope(NodeArena &arena) : m_Previous(t_ActiveArena)
+    {
+        t_ActiveArena = &arena;
+    }
+
+    NodeArena::Scope::~Scope()
+    {
+        t_ActiveArena = m_Previous;
+    }
+
+    void *ASTNode::operator new(const size_t size)
+    {
+        return AllocateNode(size);
+    }
+
+    void ASTNode::operator delete(void *node)
+    {
+        FreeNode(node);
+    }
+
     void PrintEvaluatedValue(const EvaluatedValue &value, bool raw)
     {
-        if (auto dvalue = std::get_if<double>(&value)) {
-            if (double val = *dvalue; val == static_cast<long long>(val)) {
+        if (value.IsInteger())
+            std::cout << value.AsInteger();
+        else if (value.IsNumber()) {
+            if (double val = value.AsNumber(); val == static_cast<long long>(val)) {
                 std::cout << static_cast<long long>(val);
             } else {
                 std::cout << val;
             }
         }
-        if (auto svalue = std::get_if<std::string>(&value))
-            std::cout << *svalue;
-        if (auto bvalue = std::get_if<bool>(&value))
-            std::cout << ((*bvalue) ? "True" : "False");
-        if (auto fovalue = std::get_if<FunctionStorage>(&value))
-            std::cout << "<Function: " << (*fovalue)->Name << ">" << std::endl;
-        if (auto lvalue = std::get_if<ListStorage>(&value))
+        if (value.IsString())
+            std::cout << value.AsString();
+        if (value.IsBool())
+            std::cout << (value.AsBool() ? "True" : "False");
+        if (value.IsFunction())
+            std::cout << "<Function: " << value.AsFunction().Name << ">" << std::endl;
+        if (value.IsList())
         {
+            const auto &elements = value.AsList().elements;
             std::cout << "[";
-            for (size_t i = 0; i < (*lvalue)->elements.size(); i++)
+            for (size_t i = 0; i < elements.size(); i++)
             {
-                auto &val = (*lvalue)->elements[i];
-                if (auto pvalue = std::get_if<double>(&val))
-                    std::cout << *pvalue;
-                if (auto svalue = std::get_if<std::string>(&val))
-                    std::cout << *svalue;
-                if (auto bvalue = std::get_if<bool>(&val))
-                    std::cout << ((*bvalue) ? "True" : "False");
-                if (auto llvalue = std::get_if<ListStorage>(&val))
-                    PrintEvaluatedValue(*llvalue, true);
-                if (i < (*lvalue)->elements.size() - 1)
+                auto &val = elements[i];
+                if (val.IsInteger())
+                    std::cout << val.AsInteger();
+                else if (val.IsNumber())
+                    std::cout << val.AsNumber();
+                if (val.IsString())
+                    std::cout << val.AsString();
+                if (val.IsBool())
+                    std::cout << (val.AsBool() ? "True" : "False");
+                if (val.IsList())
+                    PrintEvaluatedValue(val, true);
+                if (i < elements.size() - 1)
                     std::cout << ", ";
             }
             std::cout << "]";
         }
-        if (auto mvalue = std::get_if<MapStorage>(&value))
+        if (value.IsMap())
         {
             std::cout << "{";
-            auto &map = (*mvalue)->elements;
+            auto &map = value.AsMap().elements;
             auto it = map.begin();
             while (it != map.end())
             {
-                std::cout << "\"" << it->first << "\" = ";
+                std::cout << "\"" << it->first->Value() << "\" = ";
                 PrintEvaluatedValue(it->second, true);
                 ++it;
                 if (it != map.end())
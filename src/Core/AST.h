@@ -1,13 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <string>
 #include <memory>
 #include <utility>
-#include <variant>
 #include <vector>
 #include <optional>
 #include <unordered_map>
+#include "SourceManager.h"
 #include "Tokens.h"
+#include "Value.h"
 
 #include <filesystem>
 
@@ -24,54 +27,136 @@ namespace Aleng
     std::ostream &operator<<(std::ostream &os, const ASTNode &node);
 
     class Visitor;
-    struct ListRecursiveWrapper;
-    struct MapRecursiveWrapper;
-    struct FunctionObject;
-
-    using ListStorage = std::shared_ptr<ListRecursiveWrapper>;
-    using MapStorage = std::shared_ptr<MapRecursiveWrapper>;
-    using FunctionStorage = std::shared_ptr<FunctionObject>;
-
-    using EvaluatedValue = std::variant<
-        double,
-        std::string,
-        bool,
-        ListStorage,
-        MapStorage,
-        FunctionStorage>;
-
-    using SymbolTable = std::unordered_map<std::string, EvaluatedValue>;
+    struct Chunk;
+
+    // Charged to the account active when the table was made, like the heap values it holds.
+    using SymbolTable = std::unordered_map<StringStorage, EvaluatedValue, StringKeyHash, StringKeyEqual,
+                                           AccountedAllocator<std::pair<const StringStorage, EvaluatedValue>>>;
     using SymbolTablePtr = std::shared_ptr<SymbolTable>;
     using SymbolTableStack = std::vector<SymbolTablePtr>;
 
-    void PrintEvaluatedValue(const EvaluatedValue &value, bool raw = false);
+    // Bytes adding one name to a table may allocate: the entry's node, plus the buckets when it rehashes.
+    inline size_t SymbolTableInsertBytes(const SymbolTable &table)
+    {
+        constexpr size_t nodeBytes = sizeof(SymbolTable::value_type) + 2 * sizeof(void *);
+        const bool rehashes = static_cast<float>(table.size() + 1) > table.max_load_factor() * static_cast<float>(table.bucket_count());
+        return nodeBytes + (rehashes ? 2 * std::max<size_t>(table.bucket_count(), 8) * sizeof(void *) : 0);
+    }
+
+    // A local captured by a closure. Enclosing function and closures share it, so writes stay visible to both.
+    // An empty value has not been assigned yet and falls back to a global lookup by name, like an empty local slot.
+    struct Cell
+    {
+        std::optional<EvaluatedValue> Value;
+    };
+    using CellPtr = std::shared_ptr<Cell>;
+
+    // Where the Resolver placed a variable. LOCAL and CELL index the current call frame,
+    // UPVALUE indexes the running closure's captures and GLOBAL is looked up by name.
+    enum class BindingKind
+    {
+        GLOBAL,
+        LOCAL,
+        CELL,
+        UPVALUE
+    };
 
-    struct ListRecursiveWrapper
+    struct VariableBinding
     {
-        std::vector<EvaluatedValue> elements;
+        BindingKind Kind = BindingKind::GLOBAL;
+        int Index = -1;
 
-        ListRecursiveWrapper() = default;
+        [[nodiscard]] bool IsGlobal() const { return Kind == BindingKind::GLOBAL; }
+    };
 
-        explicit ListRecursiveWrapper(std::vector<EvaluatedValue> elems) : elements(std::move(elems)) {}
+    // Frame slots owned by a loop; they are reset every time the loop is entered.
+    struct ScopeRange
+    {
+        int LocalStart = 0;
+        int LocalEnd = 0;
+        int CellStart = 0;
+        int CellEnd = 0;
+    };
+
+    // How a closure obtains one of its upvalues when it is created.
+    struct UpvalueCapture
+    {
+        bool FromEnclosingCell = true; // otherwise from the enclosing closure's own upvalues
+        int Index = -1;
     };
 
-    struct MapRecursiveWrapper
+    // Bump allocator owning the nodes of one parsed program, so they sit together in parse order
+    // and their memory goes away in one step with the program.
+    class NodeArena
     {
-        std::unordered_map<std::string, EvaluatedValue> elements;
+    public:
+        NodeArena() = default;
+        NodeArena(const NodeArena &) = delete;
+        NodeArena &operator=(const NodeArena &) = delete;
 
-        MapRecursiveWrapper() = default;
+        void *Allocate(size_t size);
 
-        explicit MapRecursiveWrapper(std::unordered_map<std::string, EvaluatedValue> elems)
-            : elements(std::move(elems))
+        // While alive, nodes created on this thread are placed in the arena.
+        class Scope
         {
-        }
+        public:
+            explicit Scope(NodeArena &arena);
+            ~Scope();
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            NodeArena *m_Previous;
+        };
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 32 * 1024;
+
+        std::vector<std::unique_ptr<std::byte[]>> m_Blocks;
+        std::byte *m_Next = nullptr;
+        size_t m_Remaining = 0;
+    };
+
+    enum class NodeKind : uint8_t
+    {
+        PROGRAM,
+        BLOCK,
+        IF,
+        FOR_STATEMENT,
+        WHILE_STATEMENT,
+        FUNCTION_DEFINITION,
+        FUNCTION_CALL,
+        RETURN,
+        BREAK,
+        CONTINUE,
+        EQUALS_EXPRESSION,
+        BINARY_EXPRESSION,
+        UNARY_EXPRESSION,
+        IMPORT_MODULE,
+        ASSIGN_EXPRESSION,
+        MEMBER_ACCESS,
+        LIST_ACCESS,
+        MAP,
+        LIST,
+        BOOLEAN,
+        INTEGER,
+        FLOAT,
+        STRING,
+        IDENTIFIER
     };
 
     struct ASTNode
     {
         SourceRange Location;
+        // Lets consumers switch on the node type instead of probing it with dynamic_cast.
+        NodeKind Kind;
 
-        ASTNode() = default;
+        // Nodes come from the active NodeArena if there is one and from the heap otherwise.
+        // Deleting an arena node only runs its destructor; the arena releases the memory.
+        static void *operator new(size_t size);
+        static void operator delete(void *node);
+
+        explicit ASTNode(const NodeKind kind) : Kind(kind) {}
         virtual ~ASTNode() = default;
 
         ASTNode(const ASTNode &) = delete;
@@ -84,6 +169,27 @@ namespace Aleng
         virtual EvaluatedValue Accept(Visitor &visitor) const = 0;
     };
 
+    template <NodeKind K>
+    struct NodeOfKind : ASTNode
+    {
+        static constexpr NodeKind KIND = K;
+
+        NodeOfKind() : ASTNode(K) {}
+    };
+
+    // Checked downcast by kind tag; null when node is null or of another kind.
+    template <typename T>
+    T *NodeCast(ASTNode *node)
+    {
+        return node && node->Kind == T::KIND ? static_cast<T *>(node) : nullptr;
+    }
+
+    template <typename T>
+    const T *NodeCast(const ASTNode *node)
+    {
+        return node && node->Kind == T::KIND ? static_cast<const T *>(node) : nullptr;
+    }
+
     struct Parameter
     {
         std::string Name;
@@ -104,10 +210,17 @@ namespace Aleng
         return os;
     }
 
-    struct ProgramNode : ASTNode
+    struct ProgramNode : NodeOfKind<NodeKind::PROGRAM>
     {
     public:
+        // Declared before the statements so it outlives them.
+        std::unique_ptr<NodeArena> Arena;
         std::vector<NodePtr> Statements;
+        // Keeps the text the program was parsed from, so errors raised while it runs can quote it.
+        std::shared_ptr<const SourceText> Source;
+        // Frame for variables of top-level loops.
+        int LocalCount = 0;
+        int CellCount = 0;
 
         void Print(std::ostream &os) const override
         {
@@ -118,6 +231,7 @@ namespace Aleng
         [[nodiscard]] NodePtr Clone() const override
         {
             auto cloned = std::make_unique<ProgramNode>();
+            cloned->Source = Source;
             for (const auto &stmt : Statements)
             {
                 if (stmt)
@@ -128,7 +242,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct BlockNode : ASTNode
+    struct BlockNode : NodeOfKind<NodeKind::BLOCK>
     {
         std::vector<NodePtr> Statements;
         BlockNode(std::vector<NodePtr> stmts, SourceRange loc)
@@ -163,7 +277,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct IfNode : ASTNode
+    struct IfNode : NodeOfKind<NodeKind::IF>
     {
         NodePtr Condition;
         NodePtr ThenBranch;
@@ -240,7 +354,7 @@ namespace Aleng
               CollectionExpression(other.CollectionExpression ? other.CollectionExpression->Clone() : nullptr) {}
     };
 
-    struct ForStatementNode : ASTNode
+    struct ForStatementNode : NodeOfKind<NodeKind::FOR_STATEMENT>
     {
         enum class LoopType
         {
@@ -253,6 +367,8 @@ namespace Aleng
         std::optional<ForCollectionRange> CollectionLoopInfo;
 
         NodePtr Body;
+        VariableBinding IteratorBinding;
+        ScopeRange Scope;
 
         ForStatementNode(ForNumericRange numericInfo, NodePtr body, SourceRange loc)
             : Type(LoopType::NUMERIC), NumericLoopInfo(std::move(numericInfo)), Body(std::move(body))
@@ -302,16 +418,22 @@ namespace Aleng
                     NumericLoopInfo->EndExpression ? NumericLoopInfo->EndExpression->Clone() : nullptr,
                     NumericLoopInfo->StepExpression ? NumericLoopInfo->StepExpression->Clone() : nullptr,
                     NumericLoopInfo->IsUntil};
-                return std::make_unique<ForStatementNode>(
+                auto clone = std::make_unique<ForStatementNode>(
                     std::move(clonedNumericInfo), Body ? Body->Clone() : nullptr, Location);
+                clone->IteratorBinding = IteratorBinding;
+                clone->Scope = Scope;
+                return clone;
             }
             else if (Type == LoopType::COLLECTION && CollectionLoopInfo)
             {
                 ForCollectionRange clonedCollectionInfo = {
                     CollectionLoopInfo->IteratorVariableName,
                     CollectionLoopInfo->CollectionExpression ? CollectionLoopInfo->CollectionExpression->Clone() : nullptr};
-                return std::make_unique<ForStatementNode>(
+                auto clone = std::make_unique<ForStatementNode>(
                     std::move(clonedCollectionInfo), Body ? Body->Clone() : nullptr, Location);
+                clone->IteratorBinding = IteratorBinding;
+                clone->Scope = Scope;
+                return clone;
             }
             throw std::runtime_error("Invalid ForStatementNode state for cloning.");
         }
@@ -319,10 +441,11 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct WhileStatementNode : ASTNode
+    struct WhileStatementNode : NodeOfKind<NodeKind::WHILE_STATEMENT>
     {
         NodePtr Condition;
         NodePtr Body;
+        ScopeRange Scope;
 
         WhileStatementNode(NodePtr cond, NodePtr body, SourceRange loc)
             : Condition(std::move(cond)), Body(std::move(body))
@@ -342,20 +465,30 @@ namespace Aleng
 
         [[nodiscard]] NodePtr Clone() const override
         {
-            return std::make_unique<WhileStatementNode>(
+            auto clone = std::make_unique<WhileStatementNode>(
                 Condition ? Condition->Clone() : nullptr,
                 Body ? Body->Clone() : nullptr, Location);
+            clone->Scope = Scope;
+            return clone;
         }
 
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct FunctionDefinitionNode : ASTNode
+    struct FunctionDefinitionNode : NodeOfKind<NodeKind::FUNCTION_DEFINITION>
     {
         std::optional<std::string> FunctionName;
         std::vector<Parameter> Parameters;
         NodePtr Body;
         SourceRange EndLocation;
+        // Call frame layout and captures, filled in by the Resolver.
+        int LocalCount = 0;
+        int CellCount = 0;
+        std::vector<VariableBinding> ParameterBindings;
+        std::vector<UpvalueCapture> Captures;
+        VariableBinding NameBinding;
+        // Bytecode for the body, compiled on first call and shared by every closure of this definition.
+        mutable std::shared_ptr<const Chunk> CompiledBody;
 
         FunctionDefinitionNode(std::optional<std::string> funcName, std::vector<Parameter> params, NodePtr body, SourceRange loc, SourceRange endLoc)
             : FunctionName(std::move(funcName)), Parameters(std::move(params)), Body(std::move(body)), EndLocation(std::move(endLoc))
@@ -366,7 +499,12 @@ namespace Aleng
             : FunctionName(other.FunctionName),
               Parameters(other.Parameters),
               Body(other.Body ? other.Body->Clone() : nullptr),
-              EndLocation(other.EndLocation)
+              EndLocation(other.EndLocation),
+              LocalCount(other.LocalCount),
+              CellCount(other.CellCount),
+              ParameterBindings(other.ParameterBindings),
+              Captures(other.Captures),
+              NameBinding(other.NameBinding)
         {
             this->Location = other.Location;
         }
@@ -400,7 +538,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct FunctionCallNode : ASTNode
+    struct FunctionCallNode : NodeOfKind<NodeKind::FUNCTION_CALL>
     {
         NodePtr CallableExpression;
         std::vector<NodePtr> Arguments;
@@ -441,7 +579,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct ReturnNode : ASTNode
+    struct ReturnNode : NodeOfKind<NodeKind::RETURN>
     {
         NodePtr ReturnValueExpression;
 
@@ -465,7 +603,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct BreakNode : ASTNode
+    struct BreakNode : NodeOfKind<NodeKind::BREAK>
     {
         explicit BreakNode(SourceRange loc)
         {
@@ -485,7 +623,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct ContinueNode : ASTNode
+    struct ContinueNode : NodeOfKind<NodeKind::CONTINUE>
     {
         explicit ContinueNode(SourceRange loc)
         {
@@ -505,7 +643,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct EqualsExpressionNode : ASTNode
+    struct EqualsExpressionNode : NodeOfKind<NodeKind::EQUALS_EXPRESSION>
     {
         NodePtr Left;
         NodePtr Right;
@@ -543,7 +681,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct BinaryExpressionNode : ASTNode
+    struct BinaryExpressionNode : NodeOfKind<NodeKind::BINARY_EXPRESSION>
     {
         NodePtr Left;
         NodePtr Right;
@@ -582,7 +720,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct UnaryExpressionNode : ASTNode
+    struct UnaryExpressionNode : NodeOfKind<NodeKind::UNARY_EXPRESSION>
     {
         TokenType Operator;
         NodePtr Right;
@@ -608,7 +746,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct ImportModuleNode : ASTNode
+    struct ImportModuleNode : NodeOfKind<NodeKind::IMPORT_MODULE>
     {
         std::string ModuleName;
         SourceRange ModuleLocation;
@@ -637,7 +775,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct AssignExpressionNode : ASTNode
+    struct AssignExpressionNode : NodeOfKind<NodeKind::ASSIGN_EXPRESSION>
     {
         NodePtr Left;
         NodePtr Right;
@@ -673,13 +811,15 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct MemberAccessNode : ASTNode
+    struct MemberAccessNode : NodeOfKind<NodeKind::MEMBER_ACCESS>
     {
         NodePtr Object;
-        Token MemberIdentifier;
+        std::string MemberName;
+        // Shared by reads and by assignments to this member.
+        mutable MemberCache Cache;
 
-        MemberAccessNode(NodePtr obj, Token member, SourceRange loc)
-            : Object(std::move(obj)), MemberIdentifier(std::move(member))
+        MemberAccessNode(NodePtr obj, std::string member, SourceRange loc)
+            : Object(std::move(obj)), MemberName(std::move(member))
         {
             this->Location = std::move(loc);
         }
@@ -688,20 +828,31 @@ namespace Aleng
         {
             os << *Object;
             os << ".";
-            os << MemberIdentifier.Value;
+            os << MemberName;
+        }
+
+        // The member name as a map key, interned on first use.
+        const StringStorage &Interned() const
+        {
+            if (!m_Interned)
+                m_Interned = InternString(MemberName);
+            return m_Interned;
         }
 
         [[nodiscard]] NodePtr Clone() const override
         {
             return std::make_unique<MemberAccessNode>(
                 Object ? Object->Clone() : nullptr,
-                MemberIdentifier, Location);
+                MemberName, Location);
         }
 
         EvaluatedValue Accept(Visitor &visitor) const override;
+
+    private:
+        mutable StringStorage m_Interned;
     };
 
-    struct ListAccessNode : ASTNode
+    struct ListAccessNode : NodeOfKind<NodeKind::LIST_ACCESS>
     {
         NodePtr Object;
         NodePtr Index;
@@ -730,7 +881,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct MapNode : ASTNode
+    struct MapNode : NodeOfKind<NodeKind::MAP>
     {
         std::vector<std::pair<NodePtr, NodePtr>> Elements;
 
@@ -769,7 +920,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct ListNode : ASTNode
+    struct ListNode : NodeOfKind<NodeKind::LIST>
     {
         std::vector<NodePtr> Elements;
         ListNode(std::vector<NodePtr> elements, SourceRange loc)
@@ -808,7 +959,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct BooleanNode : ASTNode
+    struct BooleanNode : NodeOfKind<NodeKind::BOOLEAN>
     {
         bool Value;
         BooleanNode(bool val, SourceRange loc) : Value(val)
@@ -822,9 +973,9 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct IntegerNode : ASTNode
+    struct IntegerNode : NodeOfKind<NodeKind::INTEGER>
     {
-        long long Value;
+        int64_t Value;
 
         explicit IntegerNode(SourceRange loc)
             : Value(0)
@@ -832,7 +983,7 @@ namespace Aleng
             this->Location = std::move(loc);
         }
 
-        IntegerNode(int value, SourceRange loc)
+        IntegerNode(int64_t value, SourceRange loc)
             : Value(value)
         {
             this->Location = std::move(loc);
@@ -855,7 +1006,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct FloatNode : ASTNode
+    struct FloatNode : NodeOfKind<NodeKind::FLOAT>
     {
         float Value;
 
@@ -889,7 +1040,7 @@ namespace Aleng
         EvaluatedValue Accept(Visitor &visitor) const override;
     };
 
-    struct StringNode : ASTNode
+    struct StringNode : NodeOfKind<NodeKind::STRING>
     {
         std::string Value;
 
@@ -920,17 +1071,29 @@ namespace Aleng
             os << "\"" << Value << "\"";
         }
 
+        // The literal's runtime value. Interned on first use, so evaluating it never allocates.
+        const StringStorage &Interned() const
+        {
+            if (!m_Interned)
+                m_Interned = InternString(Value);
+            return m_Interned;
+        }
+
         [[nodiscard]] NodePtr Clone() const override
         {
             return std::make_unique<StringNode>(Value, Location);
         }
 
         EvaluatedValue Accept(Visitor &visitor) const override;
+
+    private:
+        mutable StringStorage m_Interned;
     };
 
-    struct IdentifierNode : ASTNode
+    struct IdentifierNode : NodeOfKind<NodeKind::IDENTIFIER>
     {
         std::string Value;
+        VariableBinding Binding;
 
         IdentifierNode()
         = default;
@@ -947,7 +1110,7 @@ namespace Aleng
             this->Location = std::move(loc);
         }
 
-        IdentifierNode(const IdentifierNode &other) : Value(other.Value)
+        IdentifierNode(const IdentifierNode &other) : Value(other.Value), Binding(other.Binding)
         {
             this->Location = other.Location;
         }
@@ -957,15 +1120,26 @@ namespace Aleng
             os << Value;
         }
 
+        // The name as a symbol table key, interned on first use.
+        const StringStorage &Interned() const
+        {
+            if (!m_Interned)
+                m_Interned = InternString(Value);
+            return m_Interned;
+        }
+
         [[nodiscard]] NodePtr Clone() const override
         {
-            return std::make_unique<IdentifierNode>(Value, Location);
+            return std::make_unique<IdentifierNode>(*this);
         }
 
         EvaluatedValue Accept(Visitor &visitor) const override;
+
+    private:
+        mutable StringStorage m_Interned;
     };
 
-    struct FunctionObject
+    struct alignas(8) FunctionObject : TrackedObject
     {
         std::string Name;
         enum class Type
@@ -975,12 +1149,31 @@ namespace Aleng
         };
         Type Type;
 
-        std::shared_ptr<FunctionDefinitionNode> UserFuncNodeAst;
-        SymbolTableStack CapturedEnvironment;
+        // Points into the shared program AST, which it also keeps alive.
+        std::shared_ptr<const FunctionDefinitionNode> UserFuncNodeAst;
+        // Program/module scopes visible where the function was defined; shared, never copied per closure.
+        std::shared_ptr<const SymbolTableStack> Globals;
+        std::vector<CellPtr> Upvalues;
 
-        FunctionObject(std::string n, std::shared_ptr<FunctionDefinitionNode> funcNode, SymbolTableStack stack)
-            : Name(std::move(n)), Type(Type::USER_DEFINED), UserFuncNodeAst(std::move(funcNode)), CapturedEnvironment(std::move(stack)) {}
+        FunctionObject(std::string n, std::shared_ptr<const FunctionDefinitionNode> funcNode, std::shared_ptr<const SymbolTableStack> globals, std::vector<CellPtr> upvalues)
+            : TrackedObject(ObjectKind::FUNCTION), Name(std::move(n)), Type(Type::USER_DEFINED), UserFuncNodeAst(std::move(funcNode)), Globals(std::move(globals)), Upvalues(std::move(upvalues))
+        {
+            ChargeBytes(sizeof(FunctionObject) + Name.size() + Upvalues.size() * sizeof(CellPtr));
+        }
         explicit FunctionObject(std::string n)
-            : Name(std::move(n)), Type(Type::BUILTIN), UserFuncNodeAst(nullptr) {}
+            : TrackedObject(ObjectKind::FUNCTION), Name(std::move(n)), Type(Type::BUILTIN), UserFuncNodeAst(nullptr)
+        {
+            ChargeBytes(sizeof(FunctionObject) + Name.size());
+        }
     };
+
+    inline EvaluatedValue::EvaluatedValue(const FunctionStorage &function)
+        : EvaluatedValue(function.get(), ObjectKind::FUNCTION)
+    {
+    }
+
+    inline FunctionObject &EvaluatedValue::AsFunction() const
+    {
+        return *static_cast<FunctionObject *>(AsObject());
+    }
 } // namespace Aleng
\ No newline at end of file
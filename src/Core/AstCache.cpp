@@ -0,0 +1,585 @@
+#include "AstCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "Parser.h"
+#include "SourceManager.h"
+
+namespace fs = std::filesystem;
+
+namespace Aleng
+{
+    namespace
+    {
+        constexpr std::string_view MAGIC = "ALENGC";
+        constexpr uint8_t NULL_NODE = 0xFF;
+
+        class Writer
+        {
+        public:
+            template <typename T>
+            void Raw(const T value)
+            {
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof(T));
+                m_Data.append(bytes, sizeof(T));
+            }
+
+            void String(const std::string_view value)
+            {
+                Raw(static_cast<uint32_t>(value.length()));
+                m_Data.append(value);
+            }
+
+            void Range(const SourceRange &range)
+            {
+                Raw<int32_t>(range.Start.Line);
+                Raw<int32_t>(range.Start.Column);
+                Raw<int32_t>(range.End.Line);
+                Raw<int32_t>(range.End.Column);
+            }
+
+            void Node(const ASTNode *node);
+
+            void Nodes(const std::vector<NodePtr> &nodes)
+            {
+                Raw(static_cast<uint32_t>(nodes.size()));
+                for (const auto &node : nodes)
+                    Node(node.get());
+            }
+
+            std::string Take() { return std::move(m_Data); }
+
+        private:
+            std::string m_Data;
+        };
+
+        void Writer::Node(const ASTNode *node)
+        {
+            if (!node)
+            {
+                Raw(NULL_NODE);
+                return;
+            }
+
+            Raw(static_cast<uint8_t>(node->Kind));
+            Range(node->Location);
+
+            switch (node->Kind)
+            {
+                case NodeKind::PROGRAM:
+                    Nodes(static_cast<const ProgramNode *>(node)->Statements);
+                    break;
+                case NodeKind::BLOCK:
+                    Nodes(static_cast<const BlockNode *>(node)->Statements);
+                    break;
+                case NodeKind::IF:
+                {
+                    const auto ifNode = static_cast<const IfNode *>(node);
+                    Node(ifNode->Condition.get());
+                    Node(ifNode->ThenBranch.get());
+                    Node(ifNode->ElseBranch.get());
+                    break;
+                }
+                case NodeKind::FOR_STATEMENT:
+                {
+                    const auto forNode = static_cast<const ForStatementNode *>(node);
+                    Raw(static_cast<uint8_t>(forNode->Type));
+                    if (forNode->Type == ForStatementNode::LoopType::NUMERIC)
+                    {
+                        const auto &info = *forNode->NumericLoopInfo;
+                        String(info.IteratorVariableName);
+                        Node(info.StartExpression.get());
+                        Node(info.EndExpression.get());
+                        Node(info.StepExpression.get());
+                        Raw<uint8_t>(info.IsUntil);
+                    }
+                    else
+                    {
+                        const auto &info = *forNode->CollectionLoopInfo;
+                        String(info.IteratorVariableName);
+                        Node(info.CollectionExpression.get());
+                    }
+                    Node(forNode->Body.get());
+                    break;
+                }
+                case NodeKind::WHILE_STATEMENT:
+                {
+                    const auto whileNode = static_cast<const WhileStatementNode *>(node);
+                    Node(whileNode->Condition.get());
+                    Node(whileNode->Body.get());
+                    break;
+                }
+                case NodeKind::FUNCTION_DEFINITION:
+                {
+                    const auto function = static_cast<const FunctionDefinitionNode *>(node);
+                    Raw<uint8_t>(function->FunctionName.has_value());
+                    if (function->FunctionName)
+                        String(*function->FunctionName);
+                    Raw(static_cast<uint32_t>(function->Parameters.size()));
+                    for (const auto &param : function->Parameters)
+                    {
+                        String(param.Name);
+                        Raw<uint8_t>(param.TypeName.has_value());
+                        if (param.TypeName)
+                            String(*param.TypeName);
+                        Range(param.Range);
+                        Raw<uint8_t>(param.IsVariadic);
+                    }
+                    Node(function->Body.get());
+                    Range(function->EndLocation);
+                    break;
+                }
+                case NodeKind::FUNCTION_CALL:
+                {
+                    const auto call = static_cast<const FunctionCallNode *>(node);
+                    Node(call->CallableExpression.get());
+                    Nodes(call->Arguments);
+                    break;
+                }
+                case NodeKind::RETURN:
+                    Node(static_cast<const ReturnNode *>(node)->ReturnValueExpression.get());
+                    break;
+                case NodeKind::BREAK:
+                case NodeKind::CONTINUE:
+                    break;
+                case NodeKind::EQUALS_EXPRESSION:
+                {
+                    const auto equals = static_cast<const EqualsExpressionNode *>(node);
+                    Node(equals->Left.get());
+                    Node(equals->Right.get());
+                    Raw<uint8_t>(equals->Inverse);
+                    break;
+                }
+                case NodeKind::BINARY_EXPRESSION:
+                {
+                    const auto binary = static_cast<const BinaryExpressionNode *>(node);
+                    Raw(static_cast<uint32_t>(binary->Operator));
+                    Node(binary->Left.get());
+                    Node(binary->Right.get());
+                    break;
+                }
+                case NodeKind::UNARY_EXPRESSION:
+                {
+                    const auto unary = static_cast<const UnaryExpressionNode *>(node);
+                    Raw(static_cast<uint32_t>(unary->Operator));
+                    Node(unary->Right.get());
+                    break;
+                }
+                case NodeKind::IMPORT_MODULE:
+                {
+                    const auto import = static_cast<const ImportModuleNode *>(node);
+                    String(import->ModuleName);
+                    Range(import->ModuleLocation);
+                    break;
+                }
+                case NodeKind::ASSIGN_EXPRESSION:
+                {
+                    const auto assign = static_cast<const AssignExpressionNode *>(node);
+                    Node(assign->Left.get());
+                    Node(assign->Right.get());
+                    break;
+                }
+                case NodeKind::MEMBER_ACCESS:
+                {
+                    const auto member = static_cast<const MemberAccessNode *>(node);
+                    Node(member->Object.get());
+                    String(member->MemberName);
+                    break;
+                }
+                case NodeKind::LIST_ACCESS:
+                {
+                    const auto access = static_cast<const ListAccessNode *>(node);
+                    Node(access->Object.get());
+                    Node(access->Index.get());
+                    break;
+                }
+                case NodeKind::MAP:
+                {
+                    const auto &elements = static_cast<const MapNode *>(node)->Elements;
+                    Raw(static_cast<uint32_t>(elements.size()));
+                    for (const auto &[key, value] : elements)
+                    {
+                        Node(key.get());
+                        Node(value.get());
+                    }
+                    break;
+                }
+                case NodeKind::LIST:
+                    Nodes(static_cast<const ListNode *>(node)->Elements);
+                    break;
+                case NodeKind::BOOLEAN:
+                    Raw<uint8_t>(static_cast<const BooleanNode *>(node)->Value);
+                    break;
+                case NodeKind::INTEGER:
+                    Raw<int64_t>(static_cast<const IntegerNode *>(node)->Value);
+                    break;
+                case NodeKind::FLOAT:
+                    Raw<float>(static_cast<const FloatNode *>(node)->Value);
+                    break;
+                case NodeKind::STRING:
+                    String(static_cast<const StringNode *>(node)->Value);
+                    break;
+                case NodeKind::IDENTIFIER:
+                    String(static_cast<const IdentifierNode *>(node)->Value);
+                    break;
+            }
+        }
+
+        // Reads back what Writer produced. Any inconsistency marks the whole read as failed.
+        class Reader
+        {
+        public:
+            Reader(const std::string_view data, const FileId file) : m_Data(data), m_File(file) {}
+
+            [[nodiscard]] bool Failed() const { return m_Failed; }
+            [[nodiscard]] bool AtEnd() const { return m_Position == m_Data.length(); }
+
+            template <typename T>
+            T Raw()
+            {
+                T value{};
+                if (m_Failed || m_Data.length() - m_Position < sizeof(T))
+                {
+                    m_Failed = true;
+                    return value;
+                }
+                std::memcpy(&value, m_Data.data() + m_Position, sizeof(T));
+                m_Position += sizeof(T);
+                return value;
+            }
+
+            std::string String()
+            {
+                const auto length = Raw<uint32_t>();
+                if (m_Failed || m_Data.length() - m_Position < length)
+                {
+                    m_Failed = true;
+                    return {};
+                }
+                std::string value(m_Data.substr(m_Position, length));
+                m_Position += length;
+                return value;
+            }
+
+            SourceRange Range()
+            {
+                SourceRange range;
+                range.Start.Line = Raw<int32_t>();
+                range.Start.Column = Raw<int32_t>();
+                range.End.Line = Raw<int32_t>();
+                range.End.Column = Raw<int32_t>();
+                range.File = m_File;
+                return range;
+            }
+
+            // A node, or null where the writer stored an absent optional child.
+            NodePtr Node();
+
+            // A child the node cannot do without; null fails the read.
+            NodePtr Required()
+            {
+                auto node = Node();
+                if (!node)
+                    m_Failed = true;
+                return node;
+            }
+
+            std::vector<NodePtr> Nodes()
+            {
+                std::vector<NodePtr> nodes;
+                const auto count = Raw<uint32_t>();
+                for (uint32_t i = 0; i < count && !m_Failed; i++)
+                    nodes.push_back(Required());
+                return nodes;
+            }
+
+            TokenType Operator()
+            {
+                const auto value = Raw<uint32_t>();
+                if (value > static_cast<uint32_t>(TokenType::END_OF_FILE))
+                    m_Failed = true;
+                return static_cast<TokenType>(value);
+            }
+
+        private:
+            std::string_view m_Data;
+            size_t m_Position = 0;
+            FileId m_File;
+            bool m_Failed = false;
+        };
+
+        NodePtr Reader::Node()
+        {
+            const auto kind = Raw<uint8_t>();
+            if (m_Failed || kind == NULL_NODE)
+                return nullptr;
+
+            SourceRange location = Range();
+
+            switch (static_cast<NodeKind>(kind))
+            {
+                case NodeKind::BLOCK:
+                    return std::make_unique<BlockNode>(Nodes(), location);
+                case NodeKind::IF:
+                {
+                    auto condition = Required();
+                    auto thenBranch = Required();
+                    auto elseBranch = Node();
+                    return std::make_unique<IfNode>(std::move(condition), std::move(thenBranch), std::move(elseBranch), location);
+                }
+                case NodeKind::FOR_STATEMENT:
+                {
+                    const auto type = static_cast<ForStatementNode::LoopType>(Raw<uint8_t>());
+                    if (type == ForStatementNode::LoopType::NUMERIC)
+                    {
+                        auto name = String();
+                        auto start = Required();
+                        auto end = Required();
+                        auto step = Node();
+                        const bool isUntil = Raw<uint8_t>();
+                        ForNumericRange info(std::move(name), std::move(start), std::move(end), std::move(step), isUntil);
+                        return std::make_unique<ForStatementNode>(std::move(info), Required(), location);
+                    }
+                    if (type != ForStatementNode::LoopType::COLLECTION)
+                        break;
+                    auto name = String();
+                    auto collection = Required();
+                    ForCollectionRange info(std::move(name), std::move(collection));
+                    return std::make_unique<ForStatementNode>(std::move(info), Required(), location);
+                }
+                case NodeKind::WHILE_STATEMENT:
+                {
+                    auto condition = Required();
+                    auto body = Required();
+                    return std::make_unique<WhileStatementNode>(std::move(condition), std::move(body), location);
+                }
+                case NodeKind::FUNCTION_DEFINITION:
+                {
+                    std::optional<std::string> name;
+                    if (Raw<uint8_t>())
+                        name = String();
+
+                    std::vector<Parameter> params;
+                    const auto count = Raw<uint32_t>();
+                    for (uint32_t i = 0; i < count && !m_Failed; i++)
+                    {
+                        auto paramName = String();
+                        std::optional<std::string> typeName;
+                        if (Raw<uint8_t>())
+                            typeName = String();
+                        auto range = Range();
+                        const bool isVariadic = Raw<uint8_t>();
+                        params.emplace_back(std::move(paramName), std::move(typeName), range, isVariadic);
+                    }
+
+                    auto body = Required();
+                    auto endLocation = Range();
+                    return std::make_unique<FunctionDefinitionNode>(std::move(name), std::move(params), std::move(body), location, endLocation);
+                }
+                case NodeKind::FUNCTION_CALL:
+                {
+                    auto callable = Required();
+                    auto arguments = Nodes();
+                    return std::make_unique<FunctionCallNode>(std::move(callable), std::move(arguments), location);
+                }
+                case NodeKind::RETURN:
+                    return std::make_unique<ReturnNode>(Node(), location);
+                case NodeKind::BREAK:
+                    return std::make_unique<BreakNode>(location);
+                case NodeKind::CONTINUE:
+                    return std::make_unique<ContinueNode>(location);
+                case NodeKind::EQUALS_EXPRESSION:
+                {
+                    auto left = Required();
+                    auto right = Required();
+                    const bool inverse = Raw<uint8_t>();
+                    return std::make_unique<EqualsExpressionNode>(std::move(left), std::move(right), inverse, location);
+                }
+                case NodeKind::BINARY_EXPRESSION:
+                {
+                    const auto op = Operator();
+                    auto left = Required();
+                    auto right = Required();
+                    return std::make_unique<BinaryExpressionNode>(op, std::move(left), std::move(right), location);
+                }
+                case NodeKind::UNARY_EXPRESSION:
+                {
+                    const auto op = Operator();
+                    return std::make_unique<UnaryExpressionNode>(op, Required(), location);
+                }
+                case NodeKind::IMPORT_MODULE:
+                {
+                    auto name = String();
+                    auto moduleLocation = Range();
+                    return std::make_unique<ImportModuleNode>(std::move(name), location, moduleLocation);
+                }
+                case NodeKind::ASSIGN_EXPRESSION:
+                {
+                    auto left = Required();
+                    auto right = Required();
+                    return std::make_unique<AssignExpressionNode>(std::move(left), std::move(right), location);
+                }
+                case NodeKind::MEMBER_ACCESS:
+                {
+                    auto object = Required();
+                    return std::make_unique<MemberAccessNode>(std::move(object), String(), location);
+                }
+                case NodeKind::LIST_ACCESS:
+                {
+                    auto object = Required();
+                    auto index = Required();
+                    return std::make_unique<ListAccessNode>(std::move(object), std::move(index), location);
+                }
+                case NodeKind::MAP:
+                {
+                    std::vector<std::pair<NodePtr, NodePtr>> elements;
+                    const auto count = Raw<uint32_t>();
+                    for (uint32_t i = 0; i < count && !m_Failed; i++)
+                    {
+                        auto key = Required();
+                        auto value = Required();
+                        elements.emplace_back(std::move(key), std::move(value));
+                    }
+                    return std::make_unique<MapNode>(std::move(elements), location);
+                }
+                case NodeKind::LIST:
+                    return std::make_unique<ListNode>(Nodes(), location);
+                case NodeKind::BOOLEAN:
+                    return std::make_unique<BooleanNode>(Raw<uint8_t>() != 0, location);
+                case NodeKind::INTEGER:
+                    return std::make_unique<IntegerNode>(Raw<int64_t>(), location);
+                case NodeKind::FLOAT:
+                    return std::make_unique<FloatNode>(Raw<float>(), location);
+                case NodeKind::STRING:
+                    return std::make_unique<StringNode>(String(), location);
+                case NodeKind::IDENTIFIER:
+                    return std::make_unique<IdentifierNode>(String(), location);
+                case NodeKind::PROGRAM:
+                    break;
+            }
+
+            m_Failed = true;
+            return nullptr;
+        }
+
+        bool ReadFile(const fs::path &path, std::string &contents)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open())
+                return false;
+
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            contents = buffer.str();
+            return true;
+        }
+
+        bool WriteFile(const fs::path &path, const std::string &contents)
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            return file.is_open() && file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        }
+    }
+
+    fs::path AstCache::CachePathFor(const fs::path &source)
+    {
+        auto path = source;
+        return path.replace_extension(".alengc");
+    }
+
+    uint64_t AstCache::HashSource(const std::string_view source)
+    {
+        // 64-bit FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : source)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string AstCache::Serialize(const ProgramNode &program, const uint64_t sourceHash)
+    {
+        Writer writer;
+        for (const char c : MAGIC)
+            writer.Raw(c);
+        writer.Raw(FORMAT_VERSION);
+        writer.Raw(sourceHash);
+        writer.Nodes(program.Statements);
+        return writer.Take();
+    }
+
+    std::unique_ptr<ProgramNode> AstCache::Deserialize(const std::string_view data, const uint64_t sourceHash, const FileId file)
+    {
+        Reader reader(data, file);
+        for (const char c : MAGIC)
+        {
+            if (reader.Raw<char>() != c)
+                return nullptr;
+        }
+        if (reader.Raw<uint32_t>() != FORMAT_VERSION || reader.Raw<uint64_t>() != sourceHash)
+            return nullptr;
+
+        auto program = std::make_unique<ProgramNode>();
+        program->Arena = std::make_unique<NodeArena>();
+        NodeArena::Scope arenaScope(*program->Arena);
+
+        program->Statements = reader.Nodes();
+        if (reader.Failed() || !reader.AtEnd())
+            return nullptr;
+        return program;
+    }
+
+    std::unique_ptr<ProgramNode> AstCache::Load(const std::string &sourceCode, const std::string &filepath,
+                                                std::vector<AlengError> &errors)
+    {
+        const auto cachePath = CachePathFor(filepath);
+        const uint64_t hash = HashSource(sourceCode);
+
+        std::string cached;
+        const bool hasCacheFile = ReadFile(cachePath, cached);
+        if (hasCacheFile)
+        {
+            const FileId file = SourceManager::AddFile(filepath);
+            if (auto program = Deserialize(cached, hash, file))
+            {
+                // Error reports still quote the source, which the lexer would otherwise have registered.
+                program->Source = SourceManager::SetSource(file, sourceCode);
+                return program;
+            }
+        }
+
+        Parser parser(sourceCode, filepath);
+        auto program = parser.ParseProgram();
+        if (parser.HasErrors())
+        {
+            errors.insert(errors.end(), parser.GetErrors().begin(), parser.GetErrors().end());
+            return program;
+        }
+
+        if (hasCacheFile)
+            WriteFile(cachePath, Serialize(*program, hash));
+        return program;
+    }
+
+    bool AstCache::Compile(const std::string &filepath, std::vector<AlengError> &errors)
+    {
+        std::string sourceCode;
+        if (!ReadFile(filepath, sourceCode))
+            return false;
+
+        Parser parser(sourceCode, filepath);
+        const auto program = parser.ParseProgram();
+        if (parser.HasErrors())
+        {
+            errors.insert(errors.end(), parser.GetErrors().begin(), parser.GetErrors().end());
+            return false;
+        }
+
+        return WriteFile(CachePathFor(filepath), Serialize(*program, HashSource(sourceCode)));
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AST.h"
+#include "Error.h"
+
+namespace Aleng
+{
+    // Parsed programs saved as <name>.alengc next to their source. A cached copy records the
+    // hash of the source it came from and is only used while that hash still matches.
+    class AstCache
+    {
+    public:
+        // Bumped whenever the node layout or the encoding changes.
+        static constexpr uint32_t FORMAT_VERSION = 1;
+
+        // Parses sourceCode or loads its fresh cached copy. An existing stale cache file is rewritten;
+        // files are only created by Compile. Syntax errors are appended to errors.
+        static std::unique_ptr<ProgramNode> Load(const std::string &sourceCode, const std::string &filepath,
+                                                 std::vector<AlengError> &errors);
+        // Parses a file and writes its cache file. Returns false if it could not be read or parsed.
+        static bool Compile(const std::string &filepath, std::vector<AlengError> &errors);
+
+        [[nodiscard]] static std::filesystem::path CachePathFor(const std::filesystem::path &source);
+        [[nodiscard]] static uint64_t HashSource(std::string_view source);
+
+        [[nodiscard]] static std::string Serialize(const ProgramNode &program, uint64_t sourceHash);
+        // Null if data is truncated, from another format version or made from different source.
+        [[nodiscard]] static std::unique_ptr<ProgramNode> Deserialize(std::string_view data, uint64_t sourceHash, FileId file);
+    };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AST.h"
+
+namespace Aleng
+{
+    // X-macro keeps the opcode enum and the VM dispatch table in the same order.
+    #define ALENG_OPCODES(X)                                                        \
+        X(CONSTANT)        /* push Constants[A]                                  */ \
+        X(POP)             /* discard top of stack                               */ \
+        X(LOAD_LOCAL)      /* push local slot A of the current frame             */ \
+        X(STORE_LOCAL)     /* assign local slot A = top, keeps the value         */ \
+        X(LOAD_CELL)       /* push the value of cell A of the current frame      */ \
+        X(STORE_CELL)      /* assign cell A = top, keeps the value               */ \
+        X(LOAD_UPVALUE)    /* push the value of the closure's upvalue A          */ \
+        X(STORE_UPVALUE)   /* assign upvalue A = top, keeps the value            */ \
+        X(LOAD_GLOBAL)     /* push value of Names[A]                             */ \
+        X(STORE_GLOBAL)    /* assign Names[A] = top, keeps the value             */ \
+        X(GET_INDEX)       /* object, index -> value                             */ \
+        X(SET_INDEX)       /* value, object, index -> value                      */ \
+        X(GET_MEMBER)      /* object -> value                                    */ \
+        X(SET_MEMBER)      /* value, object -> value                             */ \
+        X(ADD)                                                                      \
+        X(SUBTRACT)                                                                 \
+        X(MULTIPLY)                                                                 \
+        X(DIVIDE)                                                                   \
+        X(MODULO)                                                                   \
+        X(GREATER)                                                                  \
+        X(GREATER_EQUAL)                                                            \
+        X(LESS)                                                                     \
+        X(LESS_EQUAL)                                                               \
+        X(EQUAL)                                                                    \
+        X(NOT_EQUAL)                                                                \
+        X(NOT)                                                                      \
+        X(TRUTHY)          /* replace top with its truthiness                    */ \
+        X(JUMP)            /* ip = A                                             */ \
+        X(JUMP_IF_FALSE)   /* pop, ip = A when falsy                             */ \
+        X(LOOP)            /* ip = A; a loop back-edge, counted as a step        */ \
+        X(ENTER_SCOPE)     /* reset the loop variables in Scopes[A]              */ \
+        X(BUILD_LIST)      /* A elements -> list                                 */ \
+        X(BUILD_MAP)       /* A key/value pairs -> map                           */ \
+        X(MAKE_FUNCTION)   /* closure over the current environment               */ \
+        X(CALL)            /* callee, A arguments -> result                      */ \
+        X(IMPORT)                                                                   \
+        X(FOR_RANGE_PREP)  /* start, end[, step] -> counter, last, step (A: flags) */ \
+        X(FOR_RANGE_NEXT)  /* set iterator slot or jump to A when exhausted      */ \
+        X(FOR_RANGE_STEP)  /* advance counter; if in range set slot, jump to A   */ \
+        X(FOR_ITER_PREP)   /* collection -> iteration state                      */ \
+        X(FOR_ITER_NEXT)   /* set iterator slot or jump to A when exhausted      */ \
+        X(POP_LOOP)        /* discard A loop state slots                         */ \
+        X(EVALUATE)        /* tree-walk Node and push its value                  */ \
+        X(RETURN)
+
+    enum class OpCode : uint8_t
+    {
+        #define ALENG_OPCODE_ENUM(name) name,
+        ALENG_OPCODES(ALENG_OPCODE_ENUM)
+        #undef ALENG_OPCODE_ENUM
+    };
+
+    struct Instruction
+    {
+        OpCode Op;
+        int32_t A = 0;
+        int32_t B = 0;
+    };
+
+    constexpr int32_t FOR_RANGE_HAS_STEP = 1 << 0;
+    constexpr int32_t FOR_RANGE_UNTIL = 1 << 1;
+
+    struct Chunk
+    {
+        std::vector<Instruction> Code;
+        // Source node per instruction, used for error locations and native call contexts.
+        std::vector<const ASTNode *> Nodes;
+        std::vector<EvaluatedValue> Constants;
+        std::vector<std::string> Names;
+        std::vector<ScopeRange> Scopes;
+    };
+}
@@ -0,0 +1,397 @@
+#include "Compiler.h"
+
+#include "Error.h"
+
+namespace Aleng
+{
+    Compiler::Compiler(Chunk &chunk)
+        : m_Chunk(chunk)
+    {
+    }
+
+    std::shared_ptr<const Chunk> Compiler::CompileProgram(const ProgramNode &program)
+    {
+        auto chunk = std::make_shared<Chunk>();
+        Compiler compiler(*chunk);
+
+        const auto count = program.Statements.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto &stmt = *program.Statements[i];
+
+            // The value of a trailing expression is the program's result.
+            if (i + 1 == count && !IsStatement(stmt))
+            {
+                compiler.CompileExpression(stmt);
+                compiler.Emit(OpCode::RETURN, stmt);
+                return chunk;
+            }
+            compiler.CompileStatement(stmt);
+        }
+
+        compiler.Emit(OpCode::CONSTANT, program, compiler.AddConstant(0.0));
+        compiler.Emit(OpCode::RETURN, program);
+        return chunk;
+    }
+
+    std::shared_ptr<const Chunk> Compiler::CompileFunction(const FunctionDefinitionNode &function)
+    {
+        auto chunk = std::make_shared<Chunk>();
+        Compiler compiler(*chunk);
+
+        compiler.CompileStatement(*function.Body);
+        compiler.Emit(OpCode::CONSTANT, function, compiler.AddConstant(0.0));
+        compiler.Emit(OpCode::RETURN, function);
+        return chunk;
+    }
+
+    bool Compiler::IsStatement(const ASTNode &node)
+    {
+        switch (node.Kind)
+        {
+            case NodeKind::IF:
+            case NodeKind::FOR_STATEMENT:
+            case NodeKind::WHILE_STATEMENT:
+            case NodeKind::BLOCK:
+            case NodeKind::RETURN:
+            case NodeKind::BREAK:
+            case NodeKind::CONTINUE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void Compiler::CompileStatement(const ASTNode &node)
+    {
+        if (const auto block = NodeCast<BlockNode>(&node))
+        {
+            for (const auto &stmt : block->Statements)
+                CompileStatement(*stmt);
+        }
+        else if (const auto ifNode = NodeCast<IfNode>(&node))
+            CompileIf(*ifNode);
+        else if (const auto forNode = NodeCast<ForStatementNode>(&node))
+            CompileFor(*forNode);
+        else if (const auto whileNode = NodeCast<WhileStatementNode>(&node))
+            CompileWhile(*whileNode);
+        else if (const auto ret = NodeCast<ReturnNode>(&node))
+        {
+            if (ret->ReturnValueExpression)
+                CompileExpression(*ret->ReturnValueExpression);
+            else
+                Emit(OpCode::CONSTANT, node, AddConstant(0.0));
+            Emit(OpCode::RETURN, node);
+        }
+        else if (NodeCast<BreakNode>(&node))
+        {
+            if (m_Loops.empty())
+                throw AlengError("'Break' used outside of a loop.", node);
+            m_Loops.back().BreakJumps.push_back(Emit(OpCode::JUMP, node));
+        }
+        else if (NodeCast<ContinueNode>(&node))
+        {
+            if (m_Loops.empty())
+                throw AlengError("'Continue' used outside of a loop.", node);
+            m_Loops.back().ContinueJumps.push_back(Emit(OpCode::JUMP, node));
+        }
+        else
+        {
+            CompileExpression(node);
+            Emit(OpCode::POP, node);
+        }
+    }
+
+    void Compiler::CompileIf(const IfNode &node)
+    {
+        CompileExpression(*node.Condition);
+        const int elseJump = Emit(OpCode::JUMP_IF_FALSE, node);
+
+        CompileStatement(*node.ThenBranch);
+
+        if (node.ElseBranch)
+        {
+            const int endJump = Emit(OpCode::JUMP, node);
+            PatchJump(elseJump);
+            CompileStatement(*node.ElseBranch);
+            PatchJump(endJump);
+        }
+        else
+            PatchJump(elseJump);
+    }
+
+    void Compiler::CompileWhile(const WhileStatementNode &node)
+    {
+        EmitEnterScope(node.Scope, node);
+
+        const int loopStart = CurrentOffset();
+        CompileExpression(*node.Condition);
+        const int exitJump = Emit(OpCode::JUMP_IF_FALSE, node);
+
+        m_Loops.emplace_back();
+        CompileStatement(*node.Body);
+        Emit(OpCode::LOOP, node, loopStart);
+
+        const auto loop = std::move(m_Loops.back());
+        m_Loops.pop_back();
+
+        PatchJump(exitJump);
+        for (const int jump : loop.BreakJumps)
+            PatchJump(jump);
+        for (const int jump : loop.ContinueJumps)
+            m_Chunk.Code[jump] = {OpCode::LOOP, loopStart};
+    }
+
+    void Compiler::CompileFor(const ForStatementNode &node)
+    {
+        EmitEnterScope(node.Scope, node);
+
+        int loopStart;
+        int continueTarget;
+        int nextInstruction;
+        int stateSlots;
+
+        m_Loops.emplace_back();
+
+        if (node.Type == ForStatementNode::LoopType::NUMERIC && node.NumericLoopInfo)
+        {
+            const auto &info = *node.NumericLoopInfo;
+            int32_t flags = 0;
+
+            CompileExpression(*info.StartExpression);
+            CompileExpression(*info.EndExpression);
+            if (info.StepExpression)
+            {
+                CompileExpression(*info.StepExpression);
+                flags |= FOR_RANGE_HAS_STEP;
+            }
+            if (info.IsUntil)
+                flags |= FOR_RANGE_UNTIL;
+
+            Emit(OpCode::FOR_RANGE_PREP, node, flags);
+
+            loopStart = CurrentOffset();
+            nextInstruction = Emit(OpCode::FOR_RANGE_NEXT, node);
+            CompileStatement(*node.Body);
+
+            // The step tests the next value itself and jumps straight back into the body.
+            continueTarget = CurrentOffset();
+            Emit(OpCode::FOR_RANGE_STEP, node, loopStart + 1);
+            stateSlots = 3;
+        }
+        else if (node.Type == ForStatementNode::LoopType::COLLECTION && node.CollectionLoopInfo)
+        {
+            const auto &info = *node.CollectionLoopInfo;
+
+            CompileExpression(*info.CollectionExpression);
+            Emit(OpCode::FOR_ITER_PREP, node);
+
+            loopStart = CurrentOffset();
+            nextInstruction = Emit(OpCode::FOR_ITER_NEXT, node);
+            CompileStatement(*node.Body);
+
+            continueTarget = loopStart;
+            Emit(OpCode::LOOP, node, loopStart);
+            stateSlots = 2;
+        }
+        else
+            throw AlengError("Invalid ForStatementNode encountered during compilation.", node);
+
+        const auto loop = std::move(m_Loops.back());
+        m_Loops.pop_back();
+
+        PatchJump(nextInstruction);
+        for (const int jump : loop.BreakJumps)
+            PatchJump(jump);
+        // A continue that jumps back is a back-edge too.
+        for (const int jump : loop.ContinueJumps)
+            m_Chunk.Code[jump] = {continueTarget < jump ? OpCode::LOOP : OpCode::JUMP, continueTarget};
+
+        Emit(OpCode::POP_LOOP, node, stateSlots);
+    }
+
+    void Compiler::EmitEnterScope(const ScopeRange &range, const ASTNode &node)
+    {
+        if (range.LocalStart == range.LocalEnd && range.CellStart == range.CellEnd)
+            return;
+
+        m_Chunk.Scopes.push_back(range);
+        Emit(OpCode::ENTER_SCOPE, node, static_cast<int32_t>(m_Chunk.Scopes.size() - 1));
+    }
+
+    void Compiler::CompileExpression(const ASTNode &node)
+    {
+        if (const auto integer = NodeCast<IntegerNode>(&node))
+            Emit(OpCode::CONSTANT, node, AddConstant(integer->Value));
+        else if (const auto floating = NodeCast<FloatNode>(&node))
+            Emit(OpCode::CONSTANT, node, AddConstant(static_cast<double>(floating->Value)));
+        else if (const auto str = NodeCast<StringNode>(&node))
+            Emit(OpCode::CONSTANT, node, AddConstant(str->Interned()));
+        else if (const auto boolean = NodeCast<BooleanNode>(&node))
+            Emit(OpCode::CONSTANT, node, AddConstant(boolean->Value));
+        else if (const auto id = NodeCast<IdentifierNode>(&node))
+        {
+            switch (id->Binding.Kind)
+            {
+            case BindingKind::LOCAL: Emit(OpCode::LOAD_LOCAL, node, id->Binding.Index); break;
+            case BindingKind::CELL: Emit(OpCode::LOAD_CELL, node, id->Binding.Index); break;
+            case BindingKind::UPVALUE: Emit(OpCode::LOAD_UPVALUE, node, id->Binding.Index); break;
+            case BindingKind::GLOBAL: Emit(OpCode::LOAD_GLOBAL, node, AddName(id->Value)); break;
+            }
+        }
+        else if (const auto assign = NodeCast<AssignExpressionNode>(&node))
+            CompileAssign(*assign);
+        else if (const auto binary = NodeCast<BinaryExpressionNode>(&node))
+            CompileBinary(*binary);
+        else if (const auto equals = NodeCast<EqualsExpressionNode>(&node))
+        {
+            CompileExpression(*equals->Left);
+            CompileExpression(*equals->Right);
+            Emit(equals->Inverse ? OpCode::NOT_EQUAL : OpCode::EQUAL, node);
+        }
+        else if (const auto unary = NodeCast<UnaryExpressionNode>(&node); unary && unary->Operator == TokenType::NOT)
+        {
+            CompileExpression(*unary->Right);
+            Emit(OpCode::NOT, node);
+        }
+        else if (const auto call = NodeCast<FunctionCallNode>(&node))
+        {
+            CompileExpression(*call->CallableExpression);
+            for (const auto &arg : call->Arguments)
+                CompileExpression(*arg);
+            Emit(OpCode::CALL, node, static_cast<int32_t>(call->Arguments.size()));
+        }
+        else if (const auto member = NodeCast<MemberAccessNode>(&node))
+        {
+            CompileExpression(*member->Object);
+            Emit(OpCode::GET_MEMBER, node);
+        }
+        else if (const auto access = NodeCast<ListAccessNode>(&node))
+        {
+            CompileExpression(*access->Object);
+            CompileExpression(*access->Index);
+            Emit(OpCode::GET_INDEX, node);
+        }
+        else if (const auto list = NodeCast<ListNode>(&node))
+        {
+            for (const auto &element : list->Elements)
+                CompileExpression(*element);
+            Emit(OpCode::BUILD_LIST, node, static_cast<int32_t>(list->Elements.size()));
+        }
+        else if (const auto map = NodeCast<MapNode>(&node))
+        {
+            for (const auto &[key, value] : map->Elements)
+            {
+                CompileExpression(*key);
+                CompileExpression(*value);
+            }
+            Emit(OpCode::BUILD_MAP, node, static_cast<int32_t>(map->Elements.size()));
+        }
+        else if (NodeCast<FunctionDefinitionNode>(&node))
+            Emit(OpCode::MAKE_FUNCTION, node);
+        else if (NodeCast<ImportModuleNode>(&node))
+            Emit(OpCode::IMPORT, node);
+        else
+            Emit(OpCode::EVALUATE, node);
+    }
+
+    void Compiler::CompileAssign(const AssignExpressionNode &node)
+    {
+        CompileExpression(*node.Right);
+
+        if (const auto id = NodeCast<IdentifierNode>(node.Left.get()))
+        {
+            switch (id->Binding.Kind)
+            {
+            case BindingKind::LOCAL: Emit(OpCode::STORE_LOCAL, *id, id->Binding.Index); break;
+            case BindingKind::CELL: Emit(OpCode::STORE_CELL, *id, id->Binding.Index); break;
+            case BindingKind::UPVALUE: Emit(OpCode::STORE_UPVALUE, *id, id->Binding.Index); break;
+            case BindingKind::GLOBAL: Emit(OpCode::STORE_GLOBAL, node, AddName(id->Value)); break;
+            }
+        }
+        else if (const auto access = NodeCast<ListAccessNode>(node.Left.get()))
+        {
+            CompileExpression(*access->Object);
+            CompileExpression(*access->Index);
+            Emit(OpCode::SET_INDEX, node);
+        }
+        else if (const auto member = NodeCast<MemberAccessNode>(node.Left.get()))
+        {
+            CompileExpression(*member->Object);
+            Emit(OpCode::SET_MEMBER, node);
+        }
+        else
+            throw AlengError("Invalid left-hand side in assignment.", node);
+    }
+
+    void Compiler::CompileBinary(const BinaryExpressionNode &node)
+    {
+        if (node.Operator == TokenType::AND || node.Operator == TokenType::OR)
+        {
+            // Both operators yield a Boolean, matching the tree walker.
+            CompileExpression(*node.Left);
+            if (node.Operator == TokenType::OR)
+                Emit(OpCode::NOT, node);
+            const int shortCircuit = Emit(OpCode::JUMP_IF_FALSE, node);
+
+            CompileExpression(*node.Right);
+            Emit(OpCode::TRUTHY, node);
+            const int endJump = Emit(OpCode::JUMP, node);
+
+            PatchJump(shortCircuit);
+            Emit(OpCode::CONSTANT, node, AddConstant(node.Operator == TokenType::OR));
+            PatchJump(endJump);
+            return;
+        }
+
+        OpCode op;
+        switch (node.Operator)
+        {
+        case TokenType::PLUS: op = OpCode::ADD; break;
+        case TokenType::MINUS: op = OpCode::SUBTRACT; break;
+        case TokenType::MULTIPLY: op = OpCode::MULTIPLY; break;
+        case TokenType::DIVIDE: op = OpCode::DIVIDE; break;
+        case TokenType::MODULO: op = OpCode::MODULO; break;
+        case TokenType::GREATER: op = OpCode::GREATER; break;
+        case TokenType::GREATER_EQUAL: op = OpCode::GREATER_EQUAL; break;
+        case TokenType::MINOR: op = OpCode::LESS; break;
+        case TokenType::MINOR_EQUAL: op = OpCode::LESS_EQUAL; break;
+        default:
+            Emit(OpCode::EVALUATE, node);
+            return;
+        }
+
+        CompileExpression(*node.Left);
+        CompileExpression(*node.Right);
+        Emit(op, node);
+    }
+
+    int Compiler::Emit(const OpCode op, const ASTNode &node, const int32_t a, const int32_t b)
+    {
+        m_Chunk.Code.push_back({op, a, b});
+        m_Chunk.Nodes.push_back(&node);
+        return CurrentOffset() - 1;
+    }
+
+    void Compiler::PatchJump(const int instructionIndex)
+    {
+        m_Chunk.Code[instructionIndex].A = CurrentOffset();
+    }
+
+    int32_t Compiler::AddConstant(EvaluatedValue value)
+    {
+        m_Chunk.Constants.push_back(std::move(value));
+        return static_cast<int32_t>(m_Chunk.Constants.size() - 1);
+    }
+
+    int32_t Compiler::AddName(const std::string &name)
+    {
+        if (const auto it = m_NameIndices.find(name); it != m_NameIndices.end())
+            return it->second;
+
+        m_Chunk.Names.push_back(name);
+        const auto index = static_cast<int32_t>(m_Chunk.Names.size() - 1);
+        m_NameIndices.emplace(name, index);
+        return index;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "AST.h"
+#include "Bytecode.h"
+
+namespace Aleng
+{
+    // Lowers an AST into a flat Chunk for the VM. Variables are addressed through the
+    // bindings the Resolver assigned; loops reset their own slots on entry like the tree walker.
+    class Compiler
+    {
+    public:
+        static std::shared_ptr<const Chunk> CompileProgram(const ProgramNode &program);
+        static std::shared_ptr<const Chunk> CompileFunction(const FunctionDefinitionNode &function);
+
+    private:
+        explicit Compiler(Chunk &chunk);
+
+        void CompileStatement(const ASTNode &node);
+        void CompileExpression(const ASTNode &node);
+        void CompileFor(const ForStatementNode &node);
+        void CompileWhile(const WhileStatementNode &node);
+        void CompileIf(const IfNode &node);
+        void CompileAssign(const AssignExpressionNode &node);
+        void CompileBinary(const BinaryExpressionNode &node);
+        void EmitEnterScope(const ScopeRange &range, const ASTNode &node);
+
+        static bool IsStatement(const ASTNode &node);
+
+        int Emit(OpCode op, const ASTNode &node, int32_t a = 0, int32_t b = 0);
+        void PatchJump(int instructionIndex);
+        [[nodiscard]] int CurrentOffset() const { return static_cast<int>(m_Chunk.Code.size()); }
+
+        int32_t AddConstant(EvaluatedValue value);
+        int32_t AddName(const std::string &name);
+
+        struct LoopContext
+        {
+            std::vector<int> BreakJumps;
+            std::vector<int> ContinueJumps;
+        };
+
+    private:
+        Chunk &m_Chunk;
+        std::unordered_map<std::string, int32_t> m_NameIndices;
+        std::vector<LoopContext> m_Loops;
+    };
+}
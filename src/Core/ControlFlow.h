@@ -1,24 +1,14 @@
 #pragma once
 
-#include "AST.h"
-#include <exception>
-
 namespace Aleng
 {
-    class ReturnSignal : public std::exception
-    {
-    public:
-        EvaluatedValue Value;
-        ReturnSignal(EvaluatedValue val) : Value(std::move(val)) {}
-        const char* what() const noexcept override {
-            return "ReturnSignal (Control Flow)";
-        }
-    };
-
-    class BreakSignal : public std::exception
-    {
-    };
-    class ContinueSignal : public std::exception
+    // How the last executed statement completed. Return/Break/Continue set it and
+    // enclosing blocks, loops and calls consume it, so control flow never unwinds the C++ stack.
+    enum class CompletionType
     {
+        NORMAL,
+        RETURN,
+        BREAK,
+        CONTINUE
     };
-}
\ No newline at end of file
+}
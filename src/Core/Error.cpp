@@ -1,37 +1,24 @@
 #include "Error.h"
 
 #include <iostream>
-#include <sstream>
 
 namespace Aleng
 {
-    void PrintFormattedError(const AlengError &err, const std::string &sourceCode = "")
+    static void PrintErrorLocation(const SourceRange &range, const SourceText *source)
     {
-        std::cerr << "Runtime Error: " << err.what() << std::endl;
-
-        auto [Line, Column] = err.GetRange().Start;
-        const auto FilePath = err.GetRange().FilePath;
-        std::cerr << "  --> " << FilePath << ":" << Line+1 << ":" << Column+1 << std::endl;
+        auto [Line, Column] = range.Start;
+        std::cerr << "  --> " << range.FilePath() << ":" << Line << ":" << Column << std::endl;
         std::cerr << "    |" << std::endl;
 
-        const auto code = sourceCode.empty() ? err.GetRange().FilePath : sourceCode;
-
-        std::vector<std::string> lines;
-        std::stringstream ss(code);
-        std::string line;
-
-        while (std::getline(ss, line))
-            lines.push_back(line);
-
-        if (Line > 0 && Line <= lines.size())
+        if (const auto line = source ? source->GetLine(Line) : std::nullopt)
         {
             const std::string lineNumStr = std::to_string(Line);
-            std::cerr << " " << lineNumStr << " | " << lines[Line] << std::endl;
+            std::cerr << " " << lineNumStr << " | " << *line << std::endl;
 
             std::cerr << "    | ";
-            for (int i = 0; i < Column+1; i++)
+            for (int i = 0; i < Column - 1 && i < static_cast<int>(line->length()); i++)
             {
-                if (lines[Line][i] == '\t')
+                if ((*line)[i] == '\t')
                     std::cerr << '\t';
                 else
                     std::cerr << ' ';
@@ -43,4 +30,16 @@ namespace Aleng
             std::cerr << "    | (Could not retrieve source line)" << std::endl;
         }
     }
+
+    void PrintFormattedError(const AlengError &err)
+    {
+        std::cerr << "Runtime Error: " << err.what() << std::endl;
+        PrintErrorLocation(err.GetRange(), err.GetSource());
+    }
+
+    void PrintFormattedError(const ExecutionInterrupted &err)
+    {
+        std::cerr << "Stopped: " << err.what() << std::endl;
+        PrintErrorLocation(err.GetRange(), err.GetSource());
+    }
 }
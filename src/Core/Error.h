@@ -4,6 +4,7 @@
 #include <string>
 #include "Tokens.h"
 #include "AST.h"
+#include "SourceManager.h"
 
 namespace Aleng
 {
@@ -11,19 +12,65 @@ namespace Aleng
     {
     public:
         AlengError(const std::string &message, SourceRange location)
-            : std::runtime_error(message), m_Range(std::move(location)) {}
+            : std::runtime_error(message), m_Range(std::move(location)), m_Source(SourceManager::GetSource(m_Range.File)) {}
         AlengError(const std::string &message, const ASTNode &node)
-            : std::runtime_error(message), m_Range(node.Location) {}
+            : std::runtime_error(message), m_Range(node.Location), m_Source(SourceManager::GetSource(m_Range.File)) {}
 
         [[nodiscard]] SourceRange GetRange() const
         {
             return m_Range;
         }
 
+        // The file's text when the error was raised, so it can still be quoted after the tree is gone.
+        [[nodiscard]] const SourceText *GetSource() const
+        {
+            return m_Source.get();
+        }
+
+    private:
+        SourceRange m_Range;
+        std::shared_ptr<const SourceText> m_Source;
+    };
+
+    // Raised when a run uses up its step budget or the host interrupts it. It is not an AlengError, so
+    // code that handles script errors lets it through and the run unwinds all the way to the host.
+    class ExecutionInterrupted final : public std::runtime_error
+    {
+    public:
+        enum class Reason
+        {
+            STEP_BUDGET_EXHAUSTED,
+            INTERRUPT_REQUESTED
+        };
+
+        ExecutionInterrupted(const Reason reason, const ASTNode &node)
+            : std::runtime_error(reason == Reason::STEP_BUDGET_EXHAUSTED ? "Step budget exhausted." : "Execution interrupted."),
+              m_Reason(reason), m_Range(node.Location), m_Source(SourceManager::GetSource(m_Range.File)) {}
+
+        [[nodiscard]] Reason GetReason() const
+        {
+            return m_Reason;
+        }
+
+        // Where the run was when it stopped.
+        [[nodiscard]] SourceRange GetRange() const
+        {
+            return m_Range;
+        }
+
+        [[nodiscard]] const SourceText *GetSource() const
+        {
+            return m_Source.get();
+        }
+
     private:
+        Reason m_Reason;
         SourceRange m_Range;
+        std::shared_ptr<const SourceText> m_Source;
     };
 
-    void PrintFormattedError(const AlengError &err, const std::string &sourceCode);
+    // Quotes the offending line from the source the error kept for its file.
+    void PrintFormattedError(const AlengError &err);
+    void PrintFormattedError(const ExecutionInterrupted &err);
 
 }
\ No newline at end of file
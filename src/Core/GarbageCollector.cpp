@@ -0,0 +1,346 @@
+#include "GarbageCollector.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "AST.h"
+
+namespace Aleng
+{
+    void TrackedObject::Link()
+    {
+        GarbageCollector::Link(this);
+    }
+
+    void TrackedObject::Unlink()
+    {
+        GarbageCollector::Unlink(this);
+    }
+
+    namespace
+    {
+        struct Heap
+        {
+            TrackedObject *First = nullptr;
+            size_t Count = 0;
+            size_t Allocations = 0;
+            size_t Threshold = GarbageCollector::DEFAULT_THRESHOLD;
+            size_t Collections = 0;
+            size_t Freed = 0;
+            size_t Runs = 0;
+            bool Collecting = false;
+        };
+
+        thread_local Heap g_Heap;
+
+        // A tracked object, or a scope table, scope stack or cell reached from one. Those three are owned
+        // through std::shared_ptr: their use count stands in for the reference count, and the weak pointer
+        // lets the collector hold one later without changing the count while counting.
+        enum class NodeType
+        {
+            OBJECT,
+            STACK,
+            TABLE,
+            CELL
+        };
+
+        struct Node
+        {
+            NodeType Type;
+            const void *Address;
+            std::weak_ptr<const void> Owner;
+            int64_t Refs = 0;
+            bool Reachable = false;
+        };
+
+        class Graph
+        {
+        public:
+            // Adds every tracked object, and everything reachable from them, with its full reference count.
+            void Build(const std::vector<TrackedObject *> &objects);
+            // Subtracts the references that come from inside the graph.
+            void SubtractInternalReferences();
+            // Marks what is held from outside, and everything it reaches, as reachable.
+            void MarkReachable();
+            // Breaks the references held by unreachable nodes; returns the number of objects freed.
+            size_t FreeUnreachable();
+
+        private:
+            // Calls visit(type, address, owner) once per reference the node holds.
+            template <class F>
+            void ForEachReference(const Node &node, F &&visit) const;
+
+            size_t Add(NodeType type, const void *address, const std::weak_ptr<const void> &owner);
+
+            std::vector<Node> m_Nodes;
+            std::unordered_map<const void *, size_t> m_Index;
+        };
+
+        bool IsTrackedValue(const EvaluatedValue &value)
+        {
+            return value.IsList() || value.IsMap() || value.IsFunction();
+        }
+
+        size_t Graph::Add(const NodeType type, const void *address, const std::weak_ptr<const void> &owner)
+        {
+            const auto [it, inserted] = m_Index.try_emplace(address, m_Nodes.size());
+            if (inserted)
+            {
+                const int64_t refs = type == NodeType::OBJECT
+                                         ? static_cast<const HeapObject *>(address)->RefCount
+                                         : owner.use_count();
+                m_Nodes.push_back({type, address, owner, refs});
+            }
+            return it->second;
+        }
+
+        template <class F>
+        void Graph::ForEachReference(const Node &node, F &&visit) const
+        {
+            const auto visitValue = [&](const EvaluatedValue &value)
+            {
+                if (IsTrackedValue(value))
+                    visit(NodeType::OBJECT, value.AsObject(), std::weak_ptr<const void>());
+            };
+
+            switch (node.Type)
+            {
+            case NodeType::OBJECT:
+            {
+                const auto *object = static_cast<const HeapObject *>(node.Address);
+                if (object->Kind == ObjectKind::LIST)
+                {
+                    for (const auto &element : static_cast<const ListRecursiveWrapper *>(object)->elements)
+                        visitValue(element);
+                }
+                else if (object->Kind == ObjectKind::MAP)
+                {
+                    for (const auto &[key, value] : static_cast<const MapRecursiveWrapper *>(object)->elements)
+                        visitValue(value);
+                }
+                else if (object->Kind == ObjectKind::FUNCTION)
+                {
+                    const auto *function = static_cast<const FunctionObject *>(object);
+                    if (function->Globals)
+                        visit(NodeType::STACK, function->Globals.get(), function->Globals);
+                    for (const auto &cell : function->Upvalues)
+                    {
+                        if (cell)
+                            visit(NodeType::CELL, cell.get(), cell);
+                    }
+                }
+                break;
+            }
+            case NodeType::STACK:
+                for (const auto &table : *static_cast<const SymbolTableStack *>(node.Address))
+                {
+                    if (table)
+                        visit(NodeType::TABLE, table.get(), table);
+                }
+                break;
+            case NodeType::TABLE:
+                for (const auto &[name, value] : *static_cast<const SymbolTable *>(node.Address))
+                    visitValue(value);
+                break;
+            case NodeType::CELL:
+                if (const auto &value = static_cast<const Cell *>(node.Address)->Value)
+                    visitValue(*value);
+                break;
+            }
+        }
+
+        void Graph::Build(const std::vector<TrackedObject *> &objects)
+        {
+            m_Nodes.reserve(objects.size());
+            m_Index.reserve(objects.size());
+
+            // Every object goes in first so the nodes added while walking are only tables, stacks and cells.
+            for (auto *object : objects)
+                Add(NodeType::OBJECT, object, {});
+
+            for (size_t i = 0; i < m_Nodes.size(); i++)
+            {
+                // Adding nodes may reallocate, so walk a copy.
+                const Node node = m_Nodes[i];
+                ForEachReference(node, [&](const NodeType type, const void *address, const std::weak_ptr<const void> &owner)
+                {
+                    Add(type, address, owner);
+                });
+            }
+        }
+
+        void Graph::SubtractInternalReferences()
+        {
+            for (const auto &node : m_Nodes)
+            {
+                ForEachReference(node, [&](NodeType, const void *address, const std::weak_ptr<const void> &)
+                {
+                    m_Nodes[m_Index.at(address)].Refs--;
+                });
+            }
+        }
+
+        void Graph::MarkReachable()
+        {
+            std::vector<size_t> pending;
+            for (size_t i = 0; i < m_Nodes.size(); i++)
+            {
+                if (m_Nodes[i].Refs > 0)
+                {
+                    m_Nodes[i].Reachable = true;
+                    pending.push_back(i);
+                }
+            }
+
+            while (!pending.empty())
+            {
+                const size_t index = pending.back();
+                pending.pop_back();
+                ForEachReference(m_Nodes[index], [&](NodeType, const void *address, const std::weak_ptr<const void> &)
+                {
+                    auto &child = m_Nodes[m_Index.at(address)];
+                    if (!child.Reachable)
+                    {
+                        child.Reachable = true;
+                        pending.push_back(m_Index.at(address));
+                    }
+                });
+            }
+        }
+
+        size_t Graph::FreeUnreachable()
+        {
+            // Hold every unreachable node first, so clearing one cannot free another that is still to be cleared.
+            std::vector<HeapObject *> objects;
+            std::vector<std::shared_ptr<const void>> owners;
+            for (const auto &node : m_Nodes)
+            {
+                if (node.Reachable)
+                    continue;
+                if (node.Type == NodeType::OBJECT)
+                {
+                    auto *object = const_cast<HeapObject *>(static_cast<const HeapObject *>(node.Address));
+                    RetainObject(object);
+                    objects.push_back(object);
+                }
+                else if (auto owner = node.Owner.lock())
+                    owners.push_back(std::move(owner));
+            }
+
+            for (const auto &node : m_Nodes)
+            {
+                if (node.Reachable)
+                    continue;
+
+                auto *address = const_cast<void *>(node.Address);
+                switch (node.Type)
+                {
+                case NodeType::OBJECT:
+                {
+                    auto *object = static_cast<HeapObject *>(address);
+                    if (object->Kind == ObjectKind::LIST)
+                        static_cast<ListRecursiveWrapper *>(object)->elements.clear();
+                    else if (object->Kind == ObjectKind::MAP)
+                        static_cast<MapRecursiveWrapper *>(object)->elements = {};
+                    else if (object->Kind == ObjectKind::FUNCTION)
+                    {
+                        auto *function = static_cast<FunctionObject *>(object);
+                        function->Globals.reset();
+                        function->Upvalues.clear();
+                    }
+                    break;
+                }
+                case NodeType::STACK:
+                    // Its tables are cleared on their own, which is enough to break the cycle.
+                    break;
+                case NodeType::TABLE:
+                    static_cast<SymbolTable *>(address)->clear();
+                    break;
+                case NodeType::CELL:
+                    static_cast<Cell *>(address)->Value.reset();
+                    break;
+                }
+            }
+
+            owners.clear();
+            for (auto *object : objects)
+                ReleaseObject(object);
+            return objects.size();
+        }
+    }
+
+    void GarbageCollector::Link(TrackedObject *object)
+    {
+        object->m_Next = g_Heap.First;
+        if (g_Heap.First)
+            g_Heap.First->m_Previous = object;
+        g_Heap.First = object;
+        g_Heap.Count++;
+        g_Heap.Allocations++;
+    }
+
+    void GarbageCollector::Unlink(TrackedObject *object)
+    {
+        if (object->m_Previous)
+            object->m_Previous->m_Next = object->m_Next;
+        else
+            g_Heap.First = object->m_Next;
+        if (object->m_Next)
+            object->m_Next->m_Previous = object->m_Previous;
+        g_Heap.Count--;
+    }
+
+    size_t GarbageCollector::Collect()
+    {
+        // Freeing runs destructors, which must not start a nested collection.
+        if (g_Heap.Collecting)
+            return 0;
+        g_Heap.Collecting = true;
+
+        size_t freed;
+        {
+            std::vector<TrackedObject *> objects;
+            objects.reserve(g_Heap.Count);
+            for (auto *object = g_Heap.First; object; object = object->m_Next)
+                objects.push_back(object);
+
+            Graph graph;
+            graph.Build(objects);
+            graph.SubtractInternalReferences();
+            graph.MarkReachable();
+            freed = graph.FreeUnreachable();
+        }
+
+        g_Heap.Collecting = false;
+        g_Heap.Collections++;
+        g_Heap.Freed += freed;
+        g_Heap.Allocations = 0;
+        return freed;
+    }
+
+    void GarbageCollector::CollectIfNeeded()
+    {
+        if (g_Heap.Runs == 0 && g_Heap.Threshold != 0 && g_Heap.Allocations >= g_Heap.Threshold)
+            Collect();
+    }
+
+    GarbageCollector::RunScope::RunScope()
+    {
+        g_Heap.Runs++;
+    }
+
+    GarbageCollector::RunScope::~RunScope()
+    {
+        g_Heap.Runs--;
+    }
+
+    void GarbageCollector::SetThreshold(const size_t threshold)
+    {
+        g_Heap.Threshold = threshold;
+    }
+
+    GarbageCollectorStats GarbageCollector::GetStats()
+    {
+        return {g_Heap.Collections, g_Heap.Freed, g_Heap.Count, g_Heap.Allocations, g_Heap.Threshold};
+    }
+}
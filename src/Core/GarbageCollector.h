@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Value.h"
+
+namespace Aleng
+{
+    struct GarbageCollectorStats
+    {
+        size_t Collections = 0;
+        // Lists, maps and functions freed by the collector over the whole run.
+        size_t ObjectsFreed = 0;
+        size_t TrackedObjects = 0;
+        size_t AllocationsSinceCollection = 0;
+        size_t Threshold = 0;
+    };
+
+    // Frees reference cycles that counting alone never releases: a function stored in the scope it
+    // captured, a closure whose cell holds itself, a list that contains itself.
+    //
+    // A collection counts, for every tracked object and every scope table, scope stack and cell reachable
+    // from one, how many of its references come from inside that graph. Anything with more references than
+    // that is held from outside (a running frame, the VM stack, a visitor's scopes, the module cache), and
+    // everything reachable from it stays. The rest is garbage: its references are cleared to break the
+    // cycles and the counts free it.
+    //
+    // Each thread has its own heap, holding the objects created on it, so every interpreter on a thread
+    // shares one threshold and one set of stats. An object must be freed on the thread that created it.
+    class GarbageCollector
+    {
+    public:
+        static constexpr size_t DEFAULT_THRESHOLD = 10000;
+
+        // Runs a full collection and returns the number of lists, maps and functions freed. Only call it where
+        // every live value is held through a counted reference; calls qualify, as the interpreter holds the
+        // callee and the arguments, which is what lets std/gc collect in the middle of a script.
+        static size_t Collect();
+        // Collects once at least Threshold tracked objects were allocated since the last collection, but only
+        // outside every RunScope on this thread: between top-level runs no native frame holds a value through
+        // an uncounted pointer. Nested runs, such as an import, never collect.
+        static void CollectIfNeeded();
+
+        // Marks a run of the interpreter for CollectIfNeeded.
+        class RunScope
+        {
+        public:
+            RunScope();
+            ~RunScope();
+            RunScope(const RunScope &) = delete;
+            RunScope &operator=(const RunScope &) = delete;
+        };
+
+        // 0 disables automatic collection; Collect still works.
+        static void SetThreshold(size_t threshold);
+        [[nodiscard]] static GarbageCollectorStats GetStats();
+
+    private:
+        friend struct TrackedObject;
+
+        static void Link(TrackedObject *object);
+        static void Unlink(TrackedObject *object);
+    };
+}
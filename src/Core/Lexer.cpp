@@ -1,17 +1,18 @@
 #include "Lexer.h"
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 #include "Error.h"
+#include "SourceManager.h"
 
 namespace Aleng
 {
-    Lexer::Lexer(std::string input, std::string  filepath)
-        : m_Input(std::move(input)), m_FilePath(std::move(filepath))
+    Lexer::Lexer(std::string input, const std::string &filepath)
+        : m_FileId(SourceManager::AddFile(filepath))
     {
-        m_Line = 1;
-        m_Column = 1;
-        m_Index = 0;
+        m_Source = SourceManager::SetSource(m_FileId, std::move(input));
+        m_Input = m_Source->Text();
     }
 
     char Lexer::Peek(const int offset) const {
@@ -24,32 +25,61 @@ namespace Aleng
         char c = m_Input[m_Index];
         m_Index++;
 
-        if (c == '\n') {
-            m_Line++;
-            m_Column = 1;
-        }
-        else if ((c & 0xC0) == 0x80) {
+        if (c == '\n')
+            m_LineStarts.push_back(m_Index);
+        return c;
+    }
 
+    SourceLocation Lexer::LocationOf(const size_t offset) const
+    {
+        const auto line = std::upper_bound(m_LineStarts.begin(), m_LineStarts.end(), offset) - 1;
+
+        // Columns count UTF-16 code units: continuation bytes add nothing, 4-byte sequences add two.
+        int column = 1;
+        for (size_t i = *line; i < offset && i < m_Input.length(); i++)
+        {
+            const char c = m_Input[i];
+            if ((c & 0xC0) == 0x80)
+                continue;
+            column += (c & 0xF8) == 0xF0 ? 2 : 1;
         }
-        else if ((c & 0xF8) == 0xF0) {
-            m_Column += 2;
-        }
-        else {
-            m_Column++;
+        return {static_cast<int>(line - m_LineStarts.begin()) + 1, column};
+    }
+
+    SourceRange Lexer::RangeOf(const Token &first, const Token &last) const
+    {
+        return SourceRange{LocationOf(first.Offset), LocationOf(last.Offset + last.Length), m_FileId};
+    }
+
+    std::string Lexer::Unescape(const std::string_view raw)
+    {
+        if (raw.find('\\') == std::string_view::npos)
+            return std::string(raw);
+
+        std::string value;
+        value.reserve(raw.length());
+        for (size_t i = 0; i < raw.length(); i++)
+        {
+            if (raw[i] == '\\' && i + 1 < raw.length())
+                i++;
+            value += raw[i];
         }
-        return c;
+        return value;
+    }
+
+    Token Lexer::MakeToken(const TokenType type, const size_t start) const
+    {
+        return MakeToken(type, start, m_Input.substr(start, m_Index - start));
     }
 
-    Token Lexer::MakeToken(const TokenType type, std::string value, const SourceLocation start) const
+    Token Lexer::MakeToken(const TokenType type, const size_t start, const std::string_view value) const
     {
-        const SourceLocation end = {m_Line, m_Column};
-        return Token(type, std::move(value), SourceRange{start, end, m_FilePath});
+        return Token(type, value, static_cast<uint32_t>(start), static_cast<uint32_t>(m_Index - start));
     }
 
-    AlengError Lexer::MakeAlengError(const std::string& message, const SourceLocation location) const
+    AlengError Lexer::MakeAlengError(const std::string& message, const size_t start) const
     {
-        const SourceLocation end = {m_Line, m_Column};
-        return AlengError(message, SourceRange{location, end, m_FilePath});
+        return AlengError(message, SourceRange{LocationOf(start), LocationOf(m_Index), m_FileId});
     }
 
     void Lexer::SkipWhitespace() {
@@ -77,149 +107,152 @@ namespace Aleng
         SkipWhitespace();
 
         if (m_Index >= m_Input.length()) {
-            return MakeToken(TokenType::END_OF_FILE, "", {m_Line, m_Column});
+            return MakeToken(TokenType::END_OF_FILE, m_Index);
         }
 
-        const SourceLocation startLoc = {m_Line, m_Column};
+        const size_t start = m_Index;
         const auto c = Peek();
 
         // Number verification
         if (std::isdigit(c))
         {
-            std::string value;
-
-            while (std::isdigit(Peek())) value += Advance();
+            while (std::isdigit(Peek())) Advance();
 
             if (Peek() == '.' && std::isdigit(Peek(1)))
             {
-                value += Advance();
-                while (std::isdigit(Peek())) value += Advance();
+                Advance();
+                while (std::isdigit(Peek())) Advance();
 
-                return MakeToken(TokenType::FLOAT, value, startLoc);
+                return MakeToken(TokenType::FLOAT, start);
             }
 
-            return MakeToken(TokenType::INTEGER, value, startLoc);
+            return MakeToken(TokenType::INTEGER, start);
         }
         if (std::isalpha(c) || c == '_')
         {
-            std::string value;
-
-            while (std::isalnum(Peek()) || Peek() == '_') value += Advance();
+            while (std::isalnum(Peek()) || Peek() == '_') Advance();
+            const std::string_view value = m_Input.substr(start, m_Index - start);
 
             if (value == "If")
-                return MakeToken(TokenType::IF, value, startLoc);
+                return MakeToken(TokenType::IF, start);
             if (value == "Else")
-                return MakeToken(TokenType::ELSE, value, startLoc);
+                return MakeToken(TokenType::ELSE, start);
             if (value == "While")
-                return MakeToken(TokenType::WHILE, value, startLoc);
+                return MakeToken(TokenType::WHILE, start);
             if (value == "For")
-                return MakeToken(TokenType::FOR, value, startLoc);
+                return MakeToken(TokenType::FOR, start);
             if (value == "Fn")
-                return MakeToken(TokenType::FUNCTION, value, startLoc);
+                return MakeToken(TokenType::FUNCTION, start);
             if (value == "Return")
-                return MakeToken(TokenType::RETURN, value, startLoc);
+                return MakeToken(TokenType::RETURN, start);
             if (value == "Break")
-                return MakeToken(TokenType::BREAK, value, startLoc);
+                return MakeToken(TokenType::BREAK, start);
             if (value == "Continue")
-                return MakeToken(TokenType::CONTINUE, value, startLoc);
+                return MakeToken(TokenType::CONTINUE, start);
             if (value == "Import")
-                return MakeToken(TokenType::IMPORT, value, startLoc);
+                return MakeToken(TokenType::IMPORT, start);
             if (value == "End")
-                return MakeToken(TokenType::END, value, startLoc);
+                return MakeToken(TokenType::END, start);
             if (value == "True")
-                return MakeToken(TokenType::TRUE, value, startLoc);
+                return MakeToken(TokenType::TRUE, start);
             if (value == "False")
-                return MakeToken(TokenType::FALSE, value, startLoc);
+                return MakeToken(TokenType::FALSE, start);
             if (value == "in")
-                return MakeToken(TokenType::IN, value, startLoc);
+                return MakeToken(TokenType::IN, start);
             if (value == "until")
-                return MakeToken(TokenType::UNTIL, value, startLoc);
+                return MakeToken(TokenType::UNTIL, start);
             if (value == "step")
-                return MakeToken(TokenType::STEP, value, startLoc);
+                return MakeToken(TokenType::STEP, start);
             if (value == "and")
-                return MakeToken(TokenType::AND, value, startLoc);
+                return MakeToken(TokenType::AND, start);
             if (value == "or")
-                return MakeToken(TokenType::OR, value, startLoc);
+                return MakeToken(TokenType::OR, start);
             if (value == "not")
-                return MakeToken(TokenType::NOT, value, startLoc);
+                return MakeToken(TokenType::NOT, start);
 
-            return MakeToken(TokenType::IDENTIFIER, value, startLoc);
+            return MakeToken(TokenType::IDENTIFIER, start);
         }
 
         if (c == '$')
         {
             Advance();
-            return MakeToken(TokenType::DOLLAR, "$", startLoc);
+            return MakeToken(TokenType::DOLLAR, start);
         }
 
         if (c == '"')
         {
             Advance();
-            std::string value;
 
             while (Peek() != '"' && Peek() != '\0')
             {
                 if (Peek() == '\\')
                 {
                     Advance();
-                    if (Peek() != '\0') value += Advance();
+                    if (Peek() != '\0') Advance();
                 }
                 else
-                    value += Advance();
+                    Advance();
             }
 
-             if (Peek() != '"') throw MakeAlengError("Unterminated string", startLoc);
+            if (Peek() != '"')
+            {
+                // Recorded rather than thrown so the parser can keep going; the string runs to the end of input.
+                m_Errors.push_back(MakeAlengError("Unterminated string", start));
+                return MakeToken(TokenType::STRING, start, m_Input.substr(start + 1));
+            }
+            const std::string_view raw = m_Input.substr(start + 1, m_Index - start - 1);
             Advance();
 
-            return MakeToken(TokenType::STRING, value, startLoc);
+            return MakeToken(TokenType::STRING, start, raw);
         }
 
         switch (c) {
-            case '+': Advance(); return MakeToken(TokenType::PLUS, "+", startLoc);
-            case '-': Advance(); return MakeToken(TokenType::MINUS, "-", startLoc);
-            case '*': Advance(); return MakeToken(TokenType::MULTIPLY, "*", startLoc);
-            case '/': Advance(); return MakeToken(TokenType::DIVIDE, "/", startLoc);
-            case '%': Advance(); return MakeToken(TokenType::MODULO, "%", startLoc);
-            case '(': Advance(); return MakeToken(TokenType::LPAREN, "(", startLoc);
-            case ')': Advance(); return MakeToken(TokenType::RPAREN, ")", startLoc);
-            case '{': Advance(); return MakeToken(TokenType::LCURLY, "{", startLoc);
-            case '}': Advance(); return MakeToken(TokenType::RCURLY, "}", startLoc);
-            case '[': Advance(); return MakeToken(TokenType::LBRACE, "[", startLoc);
-            case ']': Advance(); return MakeToken(TokenType::RBRACE, "]", startLoc);
-            case ',': Advance(); return MakeToken(TokenType::COMMA, ",", startLoc);
-            case ';': Advance(); return MakeToken(TokenType::SEMICOLON, ";", startLoc);
-            case ':': Advance(); return MakeToken(TokenType::COLON, ":", startLoc);
+            case '+': Advance(); return MakeToken(TokenType::PLUS, start);
+            case '-': Advance(); return MakeToken(TokenType::MINUS, start);
+            case '*': Advance(); return MakeToken(TokenType::MULTIPLY, start);
+            case '/': Advance(); return MakeToken(TokenType::DIVIDE, start);
+            case '%': Advance(); return MakeToken(TokenType::MODULO, start);
+            case '(': Advance(); return MakeToken(TokenType::LPAREN, start);
+            case ')': Advance(); return MakeToken(TokenType::RPAREN, start);
+            case '{': Advance(); return MakeToken(TokenType::LCURLY, start);
+            case '}': Advance(); return MakeToken(TokenType::RCURLY, start);
+            case '[': Advance(); return MakeToken(TokenType::LBRACE, start);
+            case ']': Advance(); return MakeToken(TokenType::RBRACE, start);
+            case ',': Advance(); return MakeToken(TokenType::COMMA, start);
+            case ';': Advance(); return MakeToken(TokenType::SEMICOLON, start);
+            case ':': Advance(); return MakeToken(TokenType::COLON, start);
             case '.':
-                if (Peek(1) == '.') { Advance(); Advance(); return MakeToken(TokenType::RANGE, "..", startLoc); }
+                if (Peek(1) == '.') { Advance(); Advance(); return MakeToken(TokenType::RANGE, start); }
                 Advance();
-                return MakeToken(TokenType::DOT, ".", startLoc);
+                return MakeToken(TokenType::DOT, start);
             case '=':
-                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::EQUALS, "==", startLoc); }
+                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::EQUALS, start); }
                 Advance();
-                return MakeToken(TokenType::ASSIGN, "=", startLoc);
+                return MakeToken(TokenType::ASSIGN, start);
             case '!':
-                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::EQUALS, "!=", startLoc); }
+                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::EQUALS, start); }
                 Advance();
                 break;
             case '>':
-                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::GREATER_EQUAL, ">=", startLoc); }
+                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::GREATER_EQUAL, start); }
                 Advance();
-                return MakeToken(TokenType::GREATER, ">", startLoc);
+                return MakeToken(TokenType::GREATER, start);
             case '<':
-                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::MINOR_EQUAL, "<=", startLoc); }
+                if (Peek(1) == '=') { Advance(); Advance(); return MakeToken(TokenType::MINOR_EQUAL, start); }
                 Advance();
-                return MakeToken(TokenType::MINOR, "<", startLoc);
+                return MakeToken(TokenType::MINOR, start);
             default:
                 Advance();
-                return MakeToken(TokenType::UNKNOWN, std::string(1, c), startLoc);;
+                return MakeToken(TokenType::UNKNOWN, start);;
         }
 
-        return MakeToken(TokenType::UNKNOWN, std::string(1, c), startLoc);
+        return MakeToken(TokenType::UNKNOWN, start);
     }
 
     std::vector<Token> Lexer::Tokenize()
     {
         auto tokens = std::vector<Token>();
+        tokens.reserve(m_Input.length() / 4);
         Token token = Next();
         while (token.Type != TokenType::END_OF_FILE)
         {
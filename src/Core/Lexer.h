@@ -1,9 +1,12 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "Error.h"
+#include "SourceManager.h"
 #include "Tokens.h"
 
 namespace Aleng
@@ -11,25 +14,36 @@ namespace Aleng
     class Lexer
     {
     public:
-        explicit Lexer(std::string input, std::string  filepath = "unknown");
+        explicit Lexer(std::string input, const std::string &filepath = "unknown");
         std::vector<Token> Tokenize();
+        [[nodiscard]] const std::vector<AlengError> &GetErrors() const { return m_Errors; }
+        [[nodiscard]] const std::shared_ptr<const SourceText> &GetSource() const { return m_Source; }
+
+        [[nodiscard]] SourceLocation LocationOf(size_t offset) const;
+        // Spans from the start of first to the end of last.
+        [[nodiscard]] SourceRange RangeOf(const Token &first, const Token &last) const;
+
+        // Resolves the escapes in the raw text of a string token.
+        static std::string Unescape(std::string_view raw);
 
     private:
         [[nodiscard]] char Peek(int offset = 0) const;
         char Advance();
-        [[nodiscard]] Token MakeToken(TokenType type, std::string value, SourceLocation start) const;
+        [[nodiscard]] Token MakeToken(TokenType type, size_t start) const;
+        [[nodiscard]] Token MakeToken(TokenType type, size_t start, std::string_view value) const;
 
-        AlengError MakeAlengError(const std::string &message, SourceLocation location) const;
+        AlengError MakeAlengError(const std::string &message, size_t start) const;
 
         void SkipWhitespace();
 
         Token Next();
 
     private:
-        std::string m_Input;
-        std::string m_FilePath;
-        int m_Index = 0;
-        int m_Line = 1;
-        int m_Column = 1;
+        std::shared_ptr<const SourceText> m_Source; // shared with the SourceManager
+        std::string_view m_Input;
+        FileId m_FileId;
+        size_t m_Index = 0;
+        std::vector<size_t> m_LineStarts{0};
+        std::vector<AlengError> m_Errors;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace Aleng
+{
+    struct MemoryUsage
+    {
+        size_t Current = 0;
+        size_t Peak = 0;
+        // 0 when there is no limit.
+        size_t Limit = 0;
+    };
+
+    // Bytes held by the strings, lists, maps, functions, scopes and call frames one Visitor allocated.
+    // A heap value remembers the account it was charged to and credits it when freed, so the account
+    // lives until its Visitor and every value it paid for are gone. Charging never throws: the Visitor
+    // checks the limit before calls and before anything grows, where it has a location to report.
+    class MemoryAccount
+    {
+    public:
+        MemoryAccount() = default;
+        MemoryAccount(const MemoryAccount &) = delete;
+        MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+        // Account that new heap values are charged to: the running Visitor's on this thread, or none.
+        [[nodiscard]] static MemoryAccount *Active() { return s_Active; }
+
+        // Makes an account, or none, the active one until the scope ends.
+        class Scope
+        {
+        public:
+            explicit Scope(MemoryAccount *account) : m_Saved(std::exchange(s_Active, account)) {}
+            ~Scope() { s_Active = m_Saved; }
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            MemoryAccount *m_Saved;
+        };
+
+        void Retain() { ++m_RefCount; }
+        void Release()
+        {
+            if (--m_RefCount == 0)
+                delete this;
+        }
+
+        void Charge(const size_t bytes)
+        {
+            m_Current += bytes;
+            if (m_Current > m_Peak)
+                m_Peak = m_Current;
+        }
+        void Credit(const size_t bytes) { m_Current -= bytes; }
+
+        // Whether the account stays within its limit after allocating that many more bytes.
+        [[nodiscard]] bool CanCharge(const size_t bytes = 0) const { return bytes <= m_Limit && m_Current <= m_Limit - bytes; }
+
+        // 0 removes the limit.
+        void SetLimit(const size_t bytes) { m_Limit = bytes == 0 ? SIZE_MAX : bytes; }
+        [[nodiscard]] MemoryUsage GetUsage() const { return {m_Current, m_Peak, m_Limit == SIZE_MAX ? 0 : m_Limit}; }
+
+    private:
+        inline static thread_local MemoryAccount *s_Active = nullptr;
+
+        uint32_t m_RefCount = 1;
+        size_t m_Current = 0;
+        size_t m_Peak = 0;
+        size_t m_Limit = SIZE_MAX;
+    };
+
+    // Allocator for standard containers that grow outside the heap values, such as symbol tables. It charges
+    // the account active when the container was made, and a copy charges the one active when copying.
+    template <class T>
+    class AccountedAllocator
+    {
+    public:
+        using value_type = T;
+
+        AccountedAllocator() : m_Account(MemoryAccount::Active())
+        {
+            if (m_Account)
+                m_Account->Retain();
+        }
+        AccountedAllocator(const AccountedAllocator &other) : AccountedAllocator(other.m_Account) {}
+        template <class U>
+        AccountedAllocator(const AccountedAllocator<U> &other) : AccountedAllocator(other.m_Account) {}
+        AccountedAllocator &operator=(const AccountedAllocator &other)
+        {
+            AccountedAllocator copy(other);
+            std::swap(m_Account, copy.m_Account);
+            return *this;
+        }
+        ~AccountedAllocator()
+        {
+            if (m_Account)
+                m_Account->Release();
+        }
+
+        [[nodiscard]] AccountedAllocator select_on_container_copy_construction() const { return {}; }
+
+        T *allocate(const size_t count)
+        {
+            if (m_Account)
+                m_Account->Charge(count * sizeof(T));
+            return std::allocator<T>().allocate(count);
+        }
+        void deallocate(T *pointer, const size_t count)
+        {
+            if (m_Account)
+                m_Account->Credit(count * sizeof(T));
+            std::allocator<T>().deallocate(pointer, count);
+        }
+
+        template <class U>
+        bool operator==(const AccountedAllocator<U> &other) const { return m_Account == other.m_Account; }
+
+    private:
+        template <class U>
+        friend class AccountedAllocator;
+
+        explicit AccountedAllocator(MemoryAccount *account) : m_Account(account)
+        {
+            if (m_Account)
+                m_Account->Retain();
+        }
+
+        MemoryAccount *m_Account;
+    };
+}
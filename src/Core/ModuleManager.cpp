@@ -6,6 +6,7 @@
 
 #include "Error.h"
 #include "Parser.h"
+#include "StdLib.h"
 #include "Visitor.h"
 
 namespace Aleng
@@ -13,6 +14,16 @@ namespace Aleng
     ModuleManager::ModuleManager(fs::path workspaceRoot)
         : m_WorkspaceRoot(std::move(workspaceRoot))
     {
+        for (const auto &[name, source] : StdLib::GetLibraries())
+            RegisterSourceModule(name, source);
+    }
+
+    ModuleManager ModuleManager::Fork() const
+    {
+        ModuleManager fork = *this;
+        // Loaded modules hold values a script may mutate, so every fork imports its own.
+        fork.m_ModulesCache.clear();
+        return fork;
     }
 
     void ModuleManager::RegisterNativeLibrary(const std::string &name, NativeLibrary library)
@@ -20,6 +31,35 @@ namespace Aleng
         m_NativeLibraries[name] = std::move(library);
     }
 
+    void ModuleManager::RegisterSourceModule(const std::string &name, const std::string_view source)
+    {
+        m_SourceModules[name] = source;
+    }
+
+    std::shared_ptr<ProgramNode> ModuleManager::ParseSourceModule(const std::string &name, const std::string_view source)
+    {
+        // A fork may have registered other source under the name since the tree was parsed.
+        auto &[parsedSource, program] = (*m_ParsedSourceModules)[name];
+        if (!program || parsedSource.data() != source.data() || parsedSource.size() != source.size())
+        {
+            Parser parser(std::string(source), name);
+            auto ast = parser.ParseProgram();
+            if (parser.HasErrors())
+            {
+                for (const auto &err : parser.GetErrors())
+                    PrintFormattedError(err);
+                m_ParsedSourceModules->erase(name);
+                return nullptr;
+            }
+            parsedSource = source;
+            program = std::move(ast);
+        }
+
+        // The Resolver writes slot indices into the tree and the VM caches compiled bodies on it,
+        // so every import runs its own copy and the parsed tree stays untouched.
+        return std::shared_ptr<ProgramNode>(static_cast<ProgramNode *>(program->Clone().release()));
+    }
+
     void ModuleManager::RegisterModule(const std::string &name, const MapStorage &exportsMap)
     {
         m_ModulesCache[name] = exportsMap;
@@ -35,7 +75,7 @@ namespace Aleng
         if (m_NativeLibraries.contains(name))
         {
             auto [Functions, Variables] = m_NativeLibraries.at(name);
-            auto exportsMap = std::make_shared<MapRecursiveWrapper>();
+            auto exportsMap = MakeRef<MapRecursiveWrapper>();
 
             for (const auto& [funcName, funcCallback] : Functions)
             {
@@ -46,19 +86,27 @@ namespace Aleng
             {
                 if (!funcName.starts_with("native::"))
                 {
-                    exportsMap->elements[funcName] = std::make_shared<FunctionObject>(funcName);
+                    exportsMap->elements[InternString(funcName)] = MakeRef<FunctionObject>(funcName);
                 }
             }
 
             for (const auto& [varName, varValue] : Variables)
             {
-                exportsMap->elements[varName] = varValue;
+                exportsMap->elements[InternString(varName)] = varValue;
             }
 
             m_ModulesCache[name] = exportsMap;
             return exportsMap;
         }
 
+        if (const auto it = m_SourceModules.find(name); it != m_SourceModules.end())
+        {
+            auto ast = ParseSourceModule(name, it->second);
+            if (!ast)
+                return false;
+            return visitor.ExecuteAndStoreModule(std::move(ast), contextNode);
+        }
+
 
         fs::path modulePath = m_WorkspaceRoot / (name + ".aleng");
         if (!fs::exists(modulePath))
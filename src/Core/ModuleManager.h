@@ -1,5 +1,7 @@
 #pragma once
 #include <filesystem>
+#include <memory>
+#include <string_view>
 
 #include "AST.h"
 #include "Modules/NativeModule.h"
@@ -13,15 +15,35 @@ namespace Aleng
     public:
         explicit ModuleManager(fs::path workspaceRoot);
 
+        // Same root and registered libraries, but nothing loaded yet. Pair it with Visitor::Fork. The fork
+        // shares parsed source modules with this manager, so like the Visitor it stays on this thread.
+        [[nodiscard]] ModuleManager Fork() const;
+
         void RegisterNativeLibrary(const std::string& name, NativeLibrary library);
+        // Registers a module embedded as source; it is parsed and executed on its first import.
+        void RegisterSourceModule(const std::string& name, std::string_view source);
         EvaluatedValue LoadModule(const std::string& name, const ImportModuleNode& contextNode,
             Visitor& visitor);
 
         void RegisterModule(const std::string& name, const MapStorage& exportsMap);
 
     private:
+        // Parses a registered source module once per family of forks and returns a fresh copy of its tree.
+        std::shared_ptr<ProgramNode> ParseSourceModule(const std::string& name, std::string_view source);
+
         fs::path m_WorkspaceRoot;
         std::unordered_map<std::string, EvaluatedValue> m_ModulesCache = {};
         std::unordered_map<std::string, NativeLibrary> m_NativeLibraries = {};
+        std::unordered_map<std::string, std::string_view> m_SourceModules = {};
+        struct ParsedModule
+        {
+            // The registered source this tree was parsed from.
+            std::string_view Source;
+            std::shared_ptr<const ProgramNode> Program;
+        };
+        // Parsed source modules by name, never executed, only cloned. A manager and all its forks share
+        // one map, so each module is parsed once for all of them.
+        std::shared_ptr<std::unordered_map<std::string, ParsedModule>> m_ParsedSourceModules =
+            std::make_shared<std::unordered_map<std::string, ParsedModule>>();
     };
 } // Aleng
\ No newline at end of file
@@ -20,16 +20,16 @@ namespace Aleng
 
     inline bool IsTruthy(const EvaluatedValue &val)
     {
-        if (const auto pval = std::get_if<double>(&val))
-            return *pval != 0.0;
-        else if (const auto sval = std::get_if<std::string>(&val))
-            return !sval->empty();
-        else if (const auto bval = std::get_if<bool>(&val))
-            return *bval;
-        else if (const auto lval = std::get_if<ListStorage>(&val))
-            return !(*lval)->elements.empty();
-        else if (const auto mval = std::get_if<MapStorage>(&val))
-            return !(*mval)->elements.empty();
+        if (val.IsNumber())
+            return val.AsNumber() != 0.0;
+        else if (val.IsBool())
+            return val.AsBool();
+        else if (val.IsString())
+            return !val.AsString().empty();
+        else if (val.IsList())
+            return !val.AsList().elements.empty();
+        else if (val.IsMap())
+            return !val.AsMap().elements.empty();
 
         return false;
     }
@@ -41,28 +41,22 @@ namespace Aleng
     }
 
     inline double GetNumber(const FunctionCallNode& ctx, const EvaluatedValue& val, const std::string& paramName) {
-        if (const auto pNum = std::get_if<double>(&val)) {
-            return *pNum;
+        if (val.IsNumber()) {
+            return val.AsNumber();
         }
         throw AlengError("Parameter '" + paramName + "' must be a Number.", ctx);
     }
 
+    inline const std::string& GetString(const FunctionCallNode& ctx, const EvaluatedValue& val, const std::string& paramName) {
+        if (val.IsString()) {
+            return val.AsString();
+        }
+        throw AlengError("Parameter '" + paramName + "' must be a String.", ctx);
+    }
+
+    // Same type and value; lists, maps and functions compare by identity.
     inline bool ValuesAreEqual(const EvaluatedValue& a, const EvaluatedValue& b)
     {
-        bool result = false;
-        if (const auto dPtr = std::get_if<double>(&a))
-            result = *dPtr == std::get<double>(b);
-        else if (const auto strPtr = std::get_if<std::string>(&a))
-            result = *strPtr == std::get<std::string>(b);
-        else if (const auto boolPtr = std::get_if<bool>(&a))
-            result = *boolPtr == std::get<bool>(b);
-        else if (const auto listPtr = std::get_if<ListStorage>(&a))
-            result = *listPtr == std::get<ListStorage>(b);
-        else if (const auto mapPtr = std::get_if<MapStorage>(&a))
-            result = *mapPtr == std::get<MapStorage>(b);
-        else if (const auto funcPtr = std::get_if<FunctionStorage>(&a))
-            result = *funcPtr == std::get<FunctionStorage>(b);
-
-        return result;
+        return a == b;
     }
 }
@@ -0,0 +1,46 @@
+#include "NativeModule.h"
+
+#include "Core/GarbageCollector.h"
+
+namespace Aleng::StdLib
+{
+    EvaluatedValue Gc_Collect(Visitor& visitor, const std::vector<EvaluatedValue>& args, const FunctionCallNode& ctx)
+    {
+        ExpectArgs(ctx, args, 0);
+        return static_cast<int64_t>(GarbageCollector::Collect());
+    }
+
+    EvaluatedValue Gc_Stats(Visitor& visitor, const std::vector<EvaluatedValue>& args, const FunctionCallNode& ctx)
+    {
+        ExpectArgs(ctx, args, 0);
+        const auto stats = GarbageCollector::GetStats();
+
+        auto result = MakeRef<MapRecursiveWrapper>();
+        result->elements[InternString("Collections")] = static_cast<int64_t>(stats.Collections);
+        result->elements[InternString("ObjectsFreed")] = static_cast<int64_t>(stats.ObjectsFreed);
+        result->elements[InternString("TrackedObjects")] = static_cast<int64_t>(stats.TrackedObjects);
+        result->elements[InternString("AllocationsSinceCollection")] = static_cast<int64_t>(stats.AllocationsSinceCollection);
+        result->elements[InternString("Threshold")] = static_cast<int64_t>(stats.Threshold);
+        return result;
+    }
+
+    EvaluatedValue Gc_SetThreshold(Visitor& visitor, const std::vector<EvaluatedValue>& args, const FunctionCallNode& ctx)
+    {
+        ExpectArgs(ctx, args, 1);
+        const double threshold = GetNumber(ctx, args[0], "threshold");
+        if (threshold < 0)
+            throw AlengError("Parameter 'threshold' must not be negative.", ctx);
+        GarbageCollector::SetThreshold(static_cast<size_t>(threshold));
+        return 0.0;
+    }
+
+    NativeLibrary CreateGcLibrary()
+    {
+        NativeLibrary lib;
+        lib.Functions["Collect"] = Gc_Collect;
+        lib.Functions["Stats"] = Gc_Stats;
+        lib.Functions["SetThreshold"] = Gc_SetThreshold;
+
+        return lib;
+    }
+}
@@ -37,13 +37,15 @@ namespace Aleng::StdLib
             FunctionCallNode callNode(std::make_unique<IdentifierNode>(testFunc->Name, dummyLocation), {}, dummyLocation);
 
             try {
-                visitor.Visit(callNode);
+                visitor.CallFunction(*testFunc, {}, callNode);
                 std::cout << "  \033[32m✔\033[0m " << description << std::endl;
                 passed++;
             } catch (const AlengError& err) {
                 std::cout << "  \033[31m✖\033[0m " << description << std::endl;
-                std::cout << "    \033[31m[FAIL]\033[0m " << err.what() << " at " << err.GetRange().FilePath << ":" << err.GetRange().Start.Line << std::endl;
+                std::cout << "    \033[31m[FAIL]\033[0m " << err.what() << " at " << err.GetRange().FilePath() << ":" << err.GetRange().Start.Line << std::endl;
                 failed++;
+            } catch (const ExecutionInterrupted&) {
+                throw;
             } catch (const std::exception& e) {
                  std::cout << "  \033[91m✖\033[0m " << description << std::endl;
                  std::cout << "    \033[91m[ERROR]\033[0m Native C++ exception: " << e.what() << std::endl;
@@ -61,17 +63,15 @@ namespace Aleng::StdLib
     {
         ExpectArgs(ctx, args, 2);
 
-        const auto* pDescription = std::get_if<std::string>(&args[0]);
-        if (!pDescription) {
+        if (!args[0].IsString()) {
             throw AlengError("First argument to Add() must be a string description.", ctx);
         }
 
-        const auto* pFunction = std::get_if<FunctionStorage>(&args[1]);
-        if (!pFunction) {
+        if (!args[1].IsFunction()) {
             throw AlengError("Second argument to Add() must be a function.", ctx);
         }
 
-        g_TestSuites[suiteId].Tests.emplace_back(*pDescription, *pFunction);
+        g_TestSuites[suiteId].Tests.emplace_back(args[0].AsString(), FunctionStorage(&args[1].AsFunction()));
 
         return true;
     }
@@ -79,40 +79,39 @@ namespace Aleng::StdLib
     EvaluatedValue Test_CreateSuite(Visitor& visitor, const std::vector<EvaluatedValue>& args, const FunctionCallNode& ctx)
     {
         ExpectArgs(ctx, args, 1);
-        const auto* pName = std::get_if<std::string>(&args[0]);
-        if (!pName) {
+        if (!args[0].IsString()) {
             throw AlengError("Suite name must be a string.", ctx);
         }
 
         double currentId = g_NextSuiteId++;
-        g_TestSuites[currentId] = TestSuite{ *pName, {} };
+        g_TestSuites[currentId] = TestSuite{ args[0].AsString(), {} };
 
-        auto suiteObject = std::make_shared<MapRecursiveWrapper>();
+        auto suiteObject = MakeRef<MapRecursiveWrapper>();
 
         auto addFuncCallback = [currentId](Visitor& v, const std::vector<EvaluatedValue>& a, const FunctionCallNode& c) {
             return Test_AddTest(v, a, c, currentId);
         };
         std::string addFuncName = "native::test::suite" + std::to_string(currentId) + "::Add";
         visitor.RegisterBuiltinCallback(addFuncName, addFuncCallback);
-        suiteObject->elements["Add"] = std::make_shared<FunctionObject>(addFuncName);
+        suiteObject->elements[InternString("Add")] = MakeRef<FunctionObject>(addFuncName);
 
         auto runFuncCallback = [currentId](Visitor& v, const std::vector<EvaluatedValue>& a, const FunctionCallNode& c) {
             return Test_RunSuite(v, a, c, currentId);
         };
         std::string runFuncName = "native::test::suite" + std::to_string(currentId) + "::Run";
         visitor.RegisterBuiltinCallback(runFuncName, runFuncCallback);
-        suiteObject->elements["Run"] = std::make_shared<FunctionObject>(runFuncName);
+        suiteObject->elements[InternString("Run")] = MakeRef<FunctionObject>(runFuncName);
 
         return suiteObject;
     }
 
     MapStorage CreateAssertMap() {
-        auto assertMap = std::make_shared<MapRecursiveWrapper>();
+        auto assertMap = MakeRef<MapRecursiveWrapper>();
 
-        assertMap->elements["Equals"] = std::make_shared<FunctionObject>("native::test::Assert::Equals");
-        assertMap->elements["Throws"] = std::make_shared<FunctionObject>("native::test::Assert::Throws");
-        assertMap->elements["IsTrue"] = std::make_shared<FunctionObject>("native::test::Assert::IsTrue");
-        assertMap->elements["IsFalse"] = std::make_shared<FunctionObject>("native::test::Assert::IsFalse");
+        assertMap->elements[InternString("Equals")] = MakeRef<FunctionObject>("native::test::Assert::Equals");
+        assertMap->elements[InternString("Throws")] = MakeRef<FunctionObject>("native::test::Assert::Throws");
+        assertMap->elements[InternString("IsTrue")] = MakeRef<FunctionObject>("native::test::Assert::IsTrue");
+        assertMap->elements[InternString("IsFalse")] = MakeRef<FunctionObject>("native::test::Assert::IsFalse");
 
         return assertMap;
     }
@@ -126,7 +125,7 @@ namespace Aleng::StdLib
         [](Visitor&, const auto& args, const auto& ctx) {
             ExpectArgs(ctx, args, 3);
             if (!ValuesAreEqual(args[0], args[1])) {
-                throw AlengError(std::get<std::string>(args[2]), ctx);
+                throw AlengError(GetString(ctx, args[2], "message"), ctx);
             }
             return true;
         };
@@ -134,10 +133,9 @@ namespace Aleng::StdLib
         lib.Functions["native::test::Assert::Throws"] =
             [](Visitor& v, const auto& args, const auto& ctx) {
                 ExpectArgs(ctx, args, 2);
-                const auto* pFunc = std::get_if<FunctionStorage>(&args[0]);
-                if (!pFunc) throw AlengError("First argument to Throws() must be a function.", ctx);
+                if (!args[0].IsFunction()) throw AlengError("First argument to Throws() must be a function.", ctx);
 
-                FunctionCallNode callNode(std::make_unique<IdentifierNode>((*pFunc)->Name, ctx.Location), {}, ctx.Location);
+                FunctionCallNode callNode(std::make_unique<IdentifierNode>(args[0].AsFunction().Name, ctx.Location), {}, ctx.Location);
                 bool didThrow = false;
                 try {
                     v.Visit(callNode);
@@ -145,7 +143,7 @@ namespace Aleng::StdLib
                     didThrow = true;
                 }
                 if (!didThrow) {
-                    throw AlengError(std::get<std::string>(args[1]), ctx);
+                    throw AlengError(GetString(ctx, args[1], "message"), ctx);
                 }
                 return true;
         };
@@ -154,7 +152,7 @@ namespace Aleng::StdLib
         [](Visitor& v, const auto& args, const auto& ctx) {
             ExpectArgs(ctx, args, 2);
             if (!IsTruthy(args[0])) {
-                throw AlengError(std::get<std::string>(args[1]), ctx);
+                throw AlengError(GetString(ctx, args[1], "message"), ctx);
             }
             return true;
         };
@@ -163,7 +161,7 @@ namespace Aleng::StdLib
             [](Visitor& v, const auto& args, const auto& ctx) {
                 ExpectArgs(ctx, args, 2);
                 if (IsTruthy(args[0])) {
-                    throw AlengError(std::get<std::string>(args[1]), ctx);
+                    throw AlengError(GetString(ctx, args[1], "message"), ctx);
                 }
                 return true;
         };
@@ -3,6 +3,7 @@
 namespace Aleng::StdLib {
     NativeLibrary CreateMathLibrary();
     NativeLibrary CreateTestLibrary();
+    NativeLibrary CreateGcLibrary();
 }
 
 namespace Aleng {
@@ -10,5 +11,6 @@ namespace Aleng {
     {
         manager.RegisterNativeLibrary("std/math", StdLib::CreateMathLibrary());
         manager.RegisterNativeLibrary("std/test", StdLib::CreateTestLibrary());
+        manager.RegisterNativeLibrary("std/gc", StdLib::CreateGcLibrary());
     }
 }
\ No newline at end of file
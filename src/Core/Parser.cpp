@@ -1,37 +1,55 @@
 #include "AST.h"
 #include "Parser.h"
 
+#include <charconv>
 #include <iostream>
 
 #include "Error.h"
 
-// Internal exception used only for control flow during parsing errors
-struct ParserSyncException final : std::exception{};
-
 namespace Aleng
 {
-    Parser::Parser(const std::string &input, std::string filepath)
+    namespace
+    {
+        // Binding power of each binary operator, loosest first; 0 for tokens that are not one.
+        int BinaryPrecedence(const TokenType type)
+        {
+            switch (type)
+            {
+                case TokenType::OR: return 1;
+                case TokenType::AND: return 2;
+                case TokenType::EQUALS: return 3;
+                case TokenType::GREATER:
+                case TokenType::GREATER_EQUAL:
+                case TokenType::MINOR:
+                case TokenType::MINOR_EQUAL: return 4;
+                case TokenType::PLUS:
+                case TokenType::MINUS: return 5;
+                case TokenType::MULTIPLY:
+                case TokenType::DIVIDE:
+                case TokenType::MODULO: return 6;
+                default: return 0;
+            }
+        }
+    }
+
+    Parser::Parser(const std::string &input, const std::string &filepath)
+        : m_Lexer(input, filepath)
     {
-        auto lexer = Lexer(input, std::move(filepath));
-        m_Tokens = lexer.Tokenize();
+        m_Tokens = m_Lexer.Tokenize();
+        m_Errors = m_Lexer.GetErrors();
         m_Index = 0;
     }
 
     std::unique_ptr<ProgramNode> Parser::ParseProgram()
     {
         auto program = std::make_unique<ProgramNode>();
+        program->Arena = std::make_unique<NodeArena>();
+        program->Source = m_Lexer.GetSource();
+        NodeArena::Scope arenaScope(*program->Arena);
 
         while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END_OF_FILE)
         {
-            try
-            {
-                if (NodePtr stmt = Statement())
-                    program->Statements.push_back(std::move(stmt));
-            }
-            catch (const ParserSyncException&)
-            {
-                Synchronize();
-            }
+            ParseStatementInto(program->Statements);
         }
 
         return program;
@@ -62,18 +80,19 @@ namespace Aleng
                 m_Tokens[m_Index].Type != TokenType::SEMICOLON)
             {
                  returnValue = Expression();
+                 if (m_Panicking) return nullptr;
             }
-            return std::make_unique<ReturnNode>(std::move(returnValue), token.Range);
+            return std::make_unique<ReturnNode>(std::move(returnValue), RangeOf(token));
         }
         else if (token.Type == TokenType::BREAK)
         {
             m_Index++;
-            return std::make_unique<BreakNode>(token.Range);
+            return std::make_unique<BreakNode>(RangeOf(token));
         }
         else if (token.Type == TokenType::CONTINUE)
         {
             m_Index++;
-            return std::make_unique<ContinueNode>(token.Range);
+            return std::make_unique<ContinueNode>(RangeOf(token));
         }
 
         auto expr = Expression();
@@ -86,14 +105,14 @@ namespace Aleng
         m_Index++;
 
         auto condition = Expression();
+        if (m_Panicking) return nullptr;
 
         if (m_Index >= m_Tokens.size())
         {
-             ReportError("Unexpected end of file inside 'If' condition.", startToken.Range);
-             throw ParserSyncException();
+             return Fail("Unexpected end of file inside 'If' condition.", RangeOf(startToken));
         }
 
-        auto thenBlockStartLoc = m_Tokens[m_Index].Range;
+        auto thenBlockStartLoc = RangeOf(m_Tokens[m_Index]);
         std::vector<NodePtr> thenStatements;
 
         while (m_Index < m_Tokens.size() &&
@@ -101,12 +120,7 @@ namespace Aleng
                m_Tokens[m_Index].Type != TokenType::END &&
                m_Tokens[m_Index].Type != TokenType::END_OF_FILE)
         {
-            try {
-                if (auto stmt = Statement())
-                    thenStatements.push_back(std::move(stmt));
-            } catch (const ParserSyncException&) {
-                Synchronize();
-            }
+            ParseStatementInto(thenStatements);
         }
 
         NodePtr thenBranch = std::make_unique<BlockNode>(std::move(thenStatements), thenBlockStartLoc);
@@ -115,18 +129,13 @@ namespace Aleng
         if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::ELSE)
         {
             m_Index++;
-            auto elseBlockStartLoc = m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : thenBlockStartLoc;
+            auto elseBlockStartLoc = m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : thenBlockStartLoc;
             std::vector<NodePtr> elseStatements;
             while (m_Index < m_Tokens.size() &&
                    m_Tokens[m_Index].Type != TokenType::END &&
                    m_Tokens[m_Index].Type != TokenType::END_OF_FILE)
             {
-                try {
-                    if (auto stmt = Statement())
-                        elseStatements.push_back(std::move(stmt));
-                } catch (const ParserSyncException&) {
-                    Synchronize();
-                }
+                ParseStatementInto(elseStatements);
             }
             elseBranch = std::make_unique<BlockNode>(std::move(elseStatements), elseBlockStartLoc);
         }
@@ -135,15 +144,11 @@ namespace Aleng
             m_Index++;
         else
         {
-            ReportError("Expected 'End' keyword to close 'If' statement.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected 'End' keyword to close 'If' statement.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
 
         Token endToken = m_Tokens[m_Index - 1];
-        SourceRange fullRange;
-        fullRange.Start = startToken.Range.Start;
-        fullRange.End = endToken.Range.End;
-        fullRange.FilePath = startToken.Range.FilePath;
+        const SourceRange fullRange = RangeOf(startToken, endToken);
 
         return std::make_unique<IfNode>(
             std::move(condition), std::move(thenBranch), std::move(elseBranch), fullRange);
@@ -156,21 +161,19 @@ namespace Aleng
 
         if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
         {
-            ReportError("Expected iterator variable name after 'For'.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected iterator variable name after 'For'.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
 
-        std::string iteratorVarName = m_Tokens[m_Index].Value;
+        std::string iteratorVarName(m_Tokens[m_Index].Value);
         m_Index++;
 
         if (m_Index >= m_Tokens.size())
         {
-            ReportError("Unexpected end of input after For <iterator>.", m_Tokens[m_Index - 1].Range);
-            throw ParserSyncException();
+            return Fail("Unexpected end of input after For <iterator>.", RangeOf(m_Tokens[m_Index - 1]));
         }
 
         NodePtr body;
-        auto bodyStartLoc = m_Tokens[m_Index].Range;
+        auto bodyStartLoc = RangeOf(m_Tokens[m_Index]);
         std::vector<NodePtr> bodyStatements;
 
         if (m_Tokens[m_Index].Type == TokenType::ASSIGN)
@@ -178,6 +181,7 @@ namespace Aleng
             m_Index++;
 
             NodePtr startExpr = Expression();
+            if (m_Panicking) return nullptr;
             bool isUntil = false;
             NodePtr endExpr;
             NodePtr stepExpr = nullptr;
@@ -194,32 +198,27 @@ namespace Aleng
             }
             else
             {
-                ReportError("Expected '..' or 'until' in numeric For loop range.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : bodyStartLoc);
-                throw ParserSyncException();
+                return Fail("Expected '..' or 'until' in numeric For loop range.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : bodyStartLoc);
             }
 
             endExpr = Expression();
+            if (m_Panicking) return nullptr;
 
             if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::STEP)
             {
                 m_Index++;
                 stepExpr = Expression();
+                if (m_Panicking) return nullptr;
             }
 
             while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END)
             {
-                try {
-                    if (auto stmt = Statement())
-                        bodyStatements.push_back(std::move(stmt));
-                } catch (const ParserSyncException&) {
-                    Synchronize();
-                }
+                ParseStatementInto(bodyStatements);
             }
 
             if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::END)
             {
-                ReportError("Expected 'End' to close 'For' statement.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-                throw ParserSyncException();
+                return Fail("Expected 'End' to close 'For' statement.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
             }
 
             m_Index++;
@@ -227,10 +226,7 @@ namespace Aleng
             ForNumericRange numericInfo = {iteratorVarName, std::move(startExpr), std::move(endExpr), std::move(stepExpr), isUntil};
 
             Token endToken = m_Tokens[m_Index - 1];
-            SourceRange fullRange;
-            fullRange.Start = startToken.Range.Start;
-            fullRange.End = endToken.Range.End;
-            fullRange.FilePath = startToken.Range.FilePath;
+            const SourceRange fullRange = RangeOf(startToken, endToken);
 
             return std::make_unique<ForStatementNode>(numericInfo, std::move(body), fullRange);
         }
@@ -238,32 +234,26 @@ namespace Aleng
         {
             m_Index++;
             NodePtr collectionExpr = Expression();
+            if (m_Panicking) return nullptr;
 
             while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END)
             {
-                try {
-                    if (auto stmt = Statement())
-                        bodyStatements.push_back(std::move(stmt));
-                } catch (const ParserSyncException&) {
-                    Synchronize();
-                }
+                ParseStatementInto(bodyStatements);
             }
 
             if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::END)
             {
-                ReportError("Expected 'End' to close 'For' statement.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-                throw ParserSyncException();
+                return Fail("Expected 'End' to close 'For' statement.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
             }
 
             body = std::make_unique<BlockNode>(std::move(bodyStatements), bodyStartLoc);
             m_Index++;
 
             ForCollectionRange collectionInfo = {iteratorVarName, std::move(collectionExpr)};
-            return std::make_unique<ForStatementNode>(collectionInfo, std::move(body), startToken.Range);
+            return std::make_unique<ForStatementNode>(collectionInfo, std::move(body), RangeOf(startToken));
         }
 
-        ReportError("Expected '=' (for range) or 'in' (for collection) after iterator variable in For loop.", m_Tokens[m_Index].Range);
-        throw ParserSyncException();
+        return Fail("Expected '=' (for range) or 'in' (for collection) after iterator variable in For loop.", RangeOf(m_Tokens[m_Index]));
     }
 
     NodePtr Parser::ParseWhileStatement()
@@ -273,16 +263,15 @@ namespace Aleng
 
         if (m_Index >= m_Tokens.size())
         {
-            ReportError("Unexpected end of input after While keyword.", startToken.Range);
-            throw ParserSyncException();
+            return Fail("Unexpected end of input after While keyword.", RangeOf(startToken));
         }
 
         NodePtr condition = Expression();
+        if (m_Panicking) return nullptr;
 
         if (m_Index >= m_Tokens.size())
         {
-             ReportError("Unexpected end of input in While loop.", startToken.Range);
-             throw ParserSyncException();
+             return Fail("Unexpected end of input in While loop.", RangeOf(startToken));
         }
 
         auto bodyStartToken = m_Tokens[m_Index];
@@ -290,24 +279,18 @@ namespace Aleng
 
         while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END)
         {
-            try {
-                if (auto stmt = Statement())
-                    bodyStatements.push_back(std::move(stmt));
-            } catch (const ParserSyncException&) {
-                Synchronize();
-            }
+            ParseStatementInto(bodyStatements);
         }
 
         if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::END)
         {
-            ReportError("Expected 'End' to close 'While' statement.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected 'End' to close 'While' statement.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
 
         m_Index++;
-        NodePtr body = std::make_unique<BlockNode>(std::move(bodyStatements), bodyStartToken.Range);
+        NodePtr body = std::make_unique<BlockNode>(std::move(bodyStatements), RangeOf(bodyStartToken));
 
-        return std::make_unique<WhileStatementNode>(std::move(condition), std::move(body), startToken.Range);
+        return std::make_unique<WhileStatementNode>(std::move(condition), std::move(body), RangeOf(startToken));
     }
 
     NodePtr Parser::ParseFunctionDefinition()
@@ -320,17 +303,15 @@ namespace Aleng
 
         if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
         {
-            ReportError("Expected function name after 'Fn'.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected function name after 'Fn'.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
 
-        std::string funcName = m_Tokens[m_Index].Value;
+        std::string funcName(m_Tokens[m_Index].Value);
 
         m_Index++;
         if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::LPAREN)
         {
-            ReportError("Expected '(' after function name.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected '(' after function name.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
         m_Index ++;
 
@@ -341,16 +322,14 @@ namespace Aleng
         {
             if (processedVariadic)
             {
-                ReportError("Variadic parameters must be the last parameters in a function definition.", m_Tokens[m_Index].Range);
-                throw ParserSyncException();
+                return Fail("Variadic parameters must be the last parameters in a function definition.", RangeOf(m_Tokens[m_Index]));
             }
 
             if (expectComma)
             {
                 if (m_Tokens[m_Index].Type != TokenType::COMMA && m_Tokens[m_Index].Type != TokenType::RPAREN)
                 {
-                    ReportError("Expected ',' between parameters or ')' to close parameter list.", m_Tokens[m_Index].Range);
-                    throw ParserSyncException();
+                    return Fail("Expected ',' between parameters or ')' to close parameter list.", RangeOf(m_Tokens[m_Index]));
                 }
                 if (m_Tokens[m_Index].Type == TokenType::COMMA)
                     m_Index++;
@@ -368,14 +347,13 @@ namespace Aleng
 
             if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
             {
-                ReportError("Expected parameter name.", m_Tokens[m_Index].Range);
-                throw ParserSyncException();
+                return Fail("Expected parameter name.", RangeOf(m_Tokens[m_Index]));
             }
 
             auto paramToken = m_Tokens[m_Index];
-            std::string paramName = paramToken.Value;
+            std::string paramName(paramToken.Value);
             std::optional<std::string> typeName;
-            SourceRange paramRange = paramToken.Range;
+            SourceRange paramRange = RangeOf(paramToken);
 
             m_Index++;
 
@@ -384,11 +362,10 @@ namespace Aleng
                 m_Index++; // Consume ':'
                 if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
                 {
-                    ReportError("Expected type name after ':'.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : paramToken.Range);
-                    throw ParserSyncException();
+                    return Fail("Expected type name after ':'.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(paramToken));
                 }
 
-                typeName = m_Tokens[m_Index].Value;
+                typeName = std::string(m_Tokens[m_Index].Value);
                 m_Index++;
             }
 
@@ -397,33 +374,26 @@ namespace Aleng
         }
 
         if (m_Index >= m_Tokens.size()) {
-             ReportError("Unexpected end of input in function definition.", startToken.Range);
-             throw ParserSyncException();
+             return Fail("Unexpected end of input in function definition.", RangeOf(startToken));
         }
         m_Index++; // Consume ')'
 
-        auto bodyStartLoc = m_Tokens[m_Index].Range;
+        auto bodyStartLoc = RangeOf(m_Tokens[m_Index]);
         std::vector<NodePtr> bodyStatements;
         while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END && m_Tokens[m_Index].Type != TokenType::END_OF_FILE)
         {
-            try {
-                if (auto stmt = Statement())
-                    bodyStatements.push_back(std::move(stmt));
-            } catch (const ParserSyncException&) {
-                Synchronize();
-            }
+            ParseStatementInto(bodyStatements);
         }
 
         if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::END)
         {
-             ReportError("Expected 'End' to close function definition.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-             throw ParserSyncException();
+             return Fail("Expected 'End' to close function definition.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
 
         NodePtr body = std::make_unique<BlockNode>(std::move(bodyStatements), bodyStartLoc);
         m_Index++;
 
-        return std::make_unique<FunctionDefinitionNode>(std::make_optional(funcName), std::move(params), std::move(body), startToken.Range, m_Tokens[m_Index].Range);
+        return std::make_unique<FunctionDefinitionNode>(std::make_optional(funcName), std::move(params), std::move(body), RangeOf(startToken), RangeOf(m_Tokens[m_Index]));
     }
 
     NodePtr Parser::ParseFunctionLiteral()
@@ -433,8 +403,7 @@ namespace Aleng
 
         if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::LPAREN)
         {
-            ReportError("Expected '(' for anonymous function declaration or 'name' for default function declaration.", startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected '(' for anonymous function declaration or 'name' for default function declaration.", RangeOf(startToken));
         }
         m_Index++;
 
@@ -446,16 +415,14 @@ namespace Aleng
             // Parameter logic from ParseFunctionDefinition
              if (processedVariadic)
             {
-                ReportError("Variadic parameters must be the last parameters.", m_Tokens[m_Index].Range);
-                throw ParserSyncException();
+                return Fail("Variadic parameters must be the last parameters.", RangeOf(m_Tokens[m_Index]));
             }
 
             if (expectComma)
             {
                 if (m_Tokens[m_Index].Type != TokenType::COMMA && m_Tokens[m_Index].Type != TokenType::RPAREN)
                 {
-                    ReportError("Expected ',' or ')'", m_Tokens[m_Index].Range);
-                    throw ParserSyncException();
+                    return Fail("Expected ',' or ')'", RangeOf(m_Tokens[m_Index]));
                 }
                 if(m_Tokens[m_Index].Type == TokenType::COMMA) m_Index++;
             }
@@ -473,14 +440,13 @@ namespace Aleng
 
             if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
             {
-                ReportError("Expected parameter name.", m_Tokens[m_Index].Range);
-                throw ParserSyncException();
+                return Fail("Expected parameter name.", RangeOf(m_Tokens[m_Index]));
             }
 
             auto paramToken = m_Tokens[m_Index];
-            std::string paramName = paramToken.Value;
+            std::string paramName(paramToken.Value);
             std::optional<std::string> typeName;
-            SourceRange paramRange = paramToken.Range;
+            SourceRange paramRange = RangeOf(paramToken);
 
             m_Index++;
 
@@ -489,10 +455,9 @@ namespace Aleng
                 m_Index++;
                 if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
                 {
-                    ReportError("Expected type name after ':'.", m_Tokens[m_Index].Range);
-                    throw ParserSyncException();
+                    return Fail("Expected type name after ':'.", RangeOf(m_Tokens[m_Index]));
                 }
-                typeName = m_Tokens[m_Index].Value;
+                typeName = std::string(m_Tokens[m_Index].Value);
                 m_Index++;
             }
 
@@ -501,38 +466,28 @@ namespace Aleng
         }
 
         if (m_Index >= m_Tokens.size()) {
-             ReportError("Unexpected end of input.", startToken.Range);
-             throw ParserSyncException();
+             return Fail("Unexpected end of input.", RangeOf(startToken));
         }
         m_Index++; // Consume ')'
 
-        auto bodyStartLoc = m_Tokens[m_Index].Range;
+        auto bodyStartLoc = RangeOf(m_Tokens[m_Index]);
         std::vector<NodePtr> bodyStatements;
         while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END)
         {
-            try {
-                if (auto stmt = Statement())
-                    bodyStatements.push_back(std::move(stmt));
-            } catch (const ParserSyncException&) {
-                Synchronize();
-            }
+            ParseStatementInto(bodyStatements);
         }
 
         if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::END)
         {
-            ReportError("Expected 'End' to close anonymous function.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-            throw ParserSyncException();
+            return Fail("Expected 'End' to close anonymous function.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
         }
 
         NodePtr body = std::make_unique<BlockNode>(std::move(bodyStatements), bodyStartLoc);
         m_Index++;
 
-        SourceRange fullRange;
-        fullRange.Start = startToken.Range.Start;
-        fullRange.End = m_Tokens[m_Index - 1].Range.End;
-        fullRange.FilePath = startToken.Range.FilePath;
+        const SourceRange fullRange = RangeOf(startToken, m_Tokens[m_Index - 1]);
 
-        return std::make_unique<FunctionDefinitionNode>(std::nullopt, std::move(params), std::move(body), fullRange, m_Tokens[m_Index].Range);
+        return std::make_unique<FunctionDefinitionNode>(std::nullopt, std::move(params), std::move(body), fullRange, RangeOf(m_Tokens[m_Index]));
     }
 
     NodePtr Parser::ParseBlock()
@@ -540,18 +495,13 @@ namespace Aleng
         std::vector<NodePtr> statements;
         while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::END && m_Tokens[m_Index].Type != TokenType::END_OF_FILE)
         {
-             try {
-                if (auto stmt = Statement())
-                    statements.push_back(std::move(stmt));
-            } catch (const ParserSyncException&) {
-                Synchronize();
-            }
+             ParseStatementInto(statements);
         }
 
         if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::END)
             m_Index++;
 
-        return std::make_unique<BlockNode>(std::move(statements), m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : SourceRange{});
+        return std::make_unique<BlockNode>(std::move(statements), m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : SourceRange{});
     }
 
     NodePtr Parser::ParseListLiteral()
@@ -568,23 +518,23 @@ namespace Aleng
                 {
                     if (m_Tokens[m_Index].Type != TokenType::COMMA)
                     {
-                        ReportError("Expected ',' or ']' in list literal.", m_Tokens[m_Index].Range);
-                        throw ParserSyncException();
+                        return Fail("Expected ',' or ']' in list literal.", RangeOf(m_Tokens[m_Index]));
                     }
                     m_Index++;
                 }
-                elements.push_back(Expression());
+                auto element = Expression();
+                if (m_Panicking) return nullptr;
+                elements.push_back(std::move(element));
                 expectComma = true;
             } while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::COMMA);
         }
 
         if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::RBRACE)
         {
-            ReportError("Expected ']' to close list literal.", m_Tokens[m_Index-1].Range);
-            throw ParserSyncException();
+            return Fail("Expected ']' to close list literal.", RangeOf(m_Tokens[m_Index-1]));
         }
         m_Index++;
-        return std::make_unique<ListNode>(std::move(elements), m_Tokens[m_Index-1].Range);
+        return std::make_unique<ListNode>(std::move(elements), RangeOf(m_Tokens[m_Index-1]));
     }
 
     NodePtr Parser::ParseMapLiteral()
@@ -603,23 +553,23 @@ namespace Aleng
                 {
                     if (m_Tokens[m_Index].Type != TokenType::COMMA)
                     {
-                        ReportError("Expected ',' or '}' in map literal.", m_Tokens[m_Index].Range);
-                        throw ParserSyncException();
+                        return Fail("Expected ',' or '}' in map literal.", RangeOf(m_Tokens[m_Index]));
                     }
                     m_Index++;
                 }
 
                 NodePtr keyExpr = Expression();
+                if (m_Panicking) return nullptr;
 
                 if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::COLON)
                 {
-                    ReportError("Expected ':' to assign value to key in map literal.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-                    throw ParserSyncException();
+                    return Fail("Expected ':' to assign value to key in map literal.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
                 }
 
                 m_Index++;
 
                 NodePtr valueExpr = Expression();
+                if (m_Panicking) return nullptr;
 
                 elements.emplace_back(std::move(keyExpr), std::move(valueExpr));
                 expectComma = true;
@@ -627,33 +577,33 @@ namespace Aleng
 
             if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::RCURLY)
             {
-                ReportError("Expected '}' to close map literal.", m_Index < m_Tokens.size() ? m_Tokens[m_Index].Range : startToken.Range);
-                throw ParserSyncException();
+                return Fail("Expected '}' to close map literal.", m_Index < m_Tokens.size() ? RangeOf(m_Tokens[m_Index]) : RangeOf(startToken));
             }
         }
         m_Index++;
-        return std::make_unique<MapNode>(std::move(elements), startToken.Range);
+        return std::make_unique<MapNode>(std::move(elements), RangeOf(startToken));
     }
 
     NodePtr Parser::Expression()
     {
-        auto left = LogicalOrExpression();
+        auto left = BinaryExpression(1);
+        if (m_Panicking) return nullptr;
 
         if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::ASSIGN)
         {
             if (
-                !dynamic_cast<IdentifierNode *>(left.get()) && !dynamic_cast<ListAccessNode *>(left.get()) &&
-                !dynamic_cast<MemberAccessNode*>(left.get()))
+                !NodeCast<IdentifierNode>(left.get()) && !NodeCast<ListAccessNode>(left.get()) &&
+                !NodeCast<MemberAccessNode>(left.get()))
             {
-                ReportError("Invalid left-hand side in assignment expression.", m_Tokens[m_Index].Range);
-                throw ParserSyncException();
+                return Fail("Invalid left-hand side in assignment expression.", RangeOf(m_Tokens[m_Index]));
             }
 
-            SourceRange assignLocation = m_Tokens[m_Index].Range;
+            SourceRange assignLocation = RangeOf(m_Tokens[m_Index]);
 
             m_Index++;
 
             NodePtr right = Expression();
+            if (m_Panicking) return nullptr;
             return std::make_unique<AssignExpressionNode>(
                 std::move(left), std::move(right), assignLocation);
         }
@@ -661,108 +611,32 @@ namespace Aleng
         return left;
     }
 
-    NodePtr Parser::LogicalOrExpression()
+    NodePtr Parser::BinaryExpression(const int minPrecedence)
     {
-        auto left = LogicalAndExpression();
+        auto left = UnaryExpression();
+        if (m_Panicking) return nullptr;
 
-        while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::OR)
+        while (m_Index < m_Tokens.size())
         {
-            auto op = m_Tokens[m_Index];
-            m_Index++;
-            auto right = LogicalAndExpression();
-            left = std::make_unique<BinaryExpressionNode>(op.Type, std::move(left), std::move(right), m_Tokens[m_Index].Range);
-        }
-
-        return left;
-    }
-
-    NodePtr Parser::LogicalAndExpression()
-    {
-        auto left = EqualityExpression();
+            const auto op = m_Tokens[m_Index];
+            const int precedence = BinaryPrecedence(op.Type);
+            if (precedence == 0 || precedence < minPrecedence)
+                break;
 
-        while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::AND)
-        {
-            auto op = m_Tokens[m_Index];
             m_Index++;
-            auto right = EqualityExpression();
-            left = std::make_unique<BinaryExpressionNode>(op.Type, std::move(left), std::move(right), m_Tokens[m_Index].Range);
-        }
-
-        return left;
-    }
-
-    NodePtr Parser::EqualityExpression()
-    {
-        auto left = ComparisonExpression();
-
-        while (m_Index < m_Tokens.size() && (m_Tokens[m_Index].Type == TokenType::EQUALS))
-        {
-            auto op = m_Tokens[m_Index++];
-            auto right = ComparisonExpression();
+            // Every operator is left associative, so the right operand only takes tighter operators.
+            auto right = BinaryExpression(precedence + 1);
+            if (m_Panicking) return nullptr;
 
             SourceRange range;
             range.Start = left->Location.Start;
             range.End = right->Location.End;
-            range.FilePath = left->Location.FilePath;
+            range.File = left->Location.File;
 
-            left = std::make_unique<EqualsExpressionNode>(std::move(left), std::move(right), op.Value == "!=", range);
-        }
-
-        return left;
-    }
-
-    NodePtr Parser::ComparisonExpression()
-    {
-        auto left = AddictiveExpression();
-
-        while (m_Index < m_Tokens.size() && (m_Tokens[m_Index].Type == TokenType::GREATER || m_Tokens[m_Index].Type == TokenType::GREATER_EQUAL ||
-                                             m_Tokens[m_Index].Type == TokenType::MINOR || m_Tokens[m_Index].Type == TokenType::MINOR_EQUAL))
-        {
-            auto op = m_Tokens[m_Index++];
-            auto right = AddictiveExpression();
-
-            SourceRange range;
-            range.Start = left->Location.Start;
-            range.End = right->Location.End;
-            range.FilePath = left->Location.FilePath;
-
-            left = std::make_unique<BinaryExpressionNode>(op.Type, std::move(left), std::move(right), range);
-        }
-
-        return left;
-    }
-
-    NodePtr Parser::AddictiveExpression()
-    {
-        auto left = Term();
-
-        while (m_Index < m_Tokens.size() && (m_Tokens[m_Index].Type == TokenType::PLUS || m_Tokens[m_Index].Type == TokenType::MINUS))
-        {
-            auto op = m_Tokens[m_Index++];
-            auto right = Term();
-
-            SourceRange range;
-            range.Start = left->Location.Start;
-            range.End = right->Location.End;
-            range.FilePath = left->Location.FilePath;
-
-            left = std::make_unique<BinaryExpressionNode>(op.Type, std::move(left), std::move(right), range);
-        }
-
-        return left;
-    }
-
-    NodePtr Parser::Term()
-    {
-        auto left = UnaryExpression();
-
-        while (m_Index < m_Tokens.size() && (m_Tokens[m_Index].Type == TokenType::MULTIPLY || m_Tokens[m_Index].Type == TokenType::DIVIDE ||
-            m_Tokens[m_Index].Type == TokenType::MODULO))
-        {
-            auto op = m_Tokens[m_Index];
-            m_Index++;
-            auto right = UnaryExpression();
-            left = std::make_unique<BinaryExpressionNode>(op.Type, std::move(left), std::move(right), m_Tokens[m_Index].Range);
+            if (op.Type == TokenType::EQUALS)
+                left = std::make_unique<EqualsExpressionNode>(std::move(left), std::move(right), op.Value == "!=", range);
+            else
+                left = std::make_unique<BinaryExpressionNode>(op.Type, std::move(left), std::move(right), range);
         }
 
         return left;
@@ -775,13 +649,14 @@ namespace Aleng
             auto op = m_Tokens[m_Index];
             m_Index++;
             auto operand = UnaryExpression();
+            if (m_Panicking) return nullptr;
             if (op.Type == TokenType::MINUS)
             {
-                return std::make_unique<BinaryExpressionNode>(op.Type, std::make_unique<IntegerNode>(0, op.Range), std::move(operand), op.Range);
+                return std::make_unique<BinaryExpressionNode>(op.Type, std::make_unique<IntegerNode>(0, RangeOf(op)), std::move(operand), RangeOf(op));
             }
             else
             {
-                return std::make_unique<UnaryExpressionNode>(op.Type, std::move(operand), op.Range);
+                return std::make_unique<UnaryExpressionNode>(op.Type, std::move(operand), RangeOf(op));
             }
         }
 
@@ -791,8 +666,7 @@ namespace Aleng
     NodePtr Parser::Factor()
     {
         if (m_Index >= m_Tokens.size()) {
-             ReportError("Unexpected end of expression.", m_Index > 0 ? m_Tokens[m_Index-1].Range : SourceRange{});
-             throw ParserSyncException();
+             return Fail("Unexpected end of expression.", m_Index > 0 ? RangeOf(m_Tokens[m_Index-1]) : SourceRange{});
         }
 
         auto token = m_Tokens[m_Index];
@@ -801,28 +675,36 @@ namespace Aleng
         if (token.Type == TokenType::TRUE)
         {
             m_Index++;
-            primaryExpr = std::make_unique<BooleanNode>(true, token.Range);
+            primaryExpr = std::make_unique<BooleanNode>(true, RangeOf(token));
         }
         else if (token.Type == TokenType::FALSE)
         {
             m_Index++;
-            primaryExpr = std::make_unique<BooleanNode>(false, token.Range);
+            primaryExpr = std::make_unique<BooleanNode>(false, RangeOf(token));
         }
         else if (token.Type == TokenType::INTEGER)
         {
             m_Index++;
-            primaryExpr = std::make_unique<IntegerNode>(std::stoll(token.Value), token.Range);
+            int64_t value = 0;
+            const auto [end, error] = std::from_chars(token.Value.data(), token.Value.data() + token.Value.size(), value);
+            if (error != std::errc() || end != token.Value.data() + token.Value.size())
+                return Fail("Integer literal '" + std::string(token.Value) + "' is out of range.", RangeOf(token));
+            primaryExpr = std::make_unique<IntegerNode>(value, RangeOf(token));
         }
         else if (token.Type == TokenType::FLOAT)
         {
             m_Index++;
-            primaryExpr = std::make_unique<FloatNode>(std::stof(token.Value), token.Range);
+            float value = 0.0f;
+            const auto [end, error] = std::from_chars(token.Value.data(), token.Value.data() + token.Value.size(), value);
+            if (error != std::errc() || end != token.Value.data() + token.Value.size())
+                return Fail("Number literal '" + std::string(token.Value) + "' is out of range.", RangeOf(token));
+            primaryExpr = std::make_unique<FloatNode>(value, RangeOf(token));
         }
 
         else if (token.Type == TokenType::STRING)
         {
             m_Index++;
-            primaryExpr = std::make_unique<StringNode>(token.Value, token.Range);
+            primaryExpr = std::make_unique<StringNode>(Lexer::Unescape(token.Value), RangeOf(token));
         }
         else if (token.Type == TokenType::LBRACE)
             primaryExpr = ParseListLiteral();
@@ -830,10 +712,10 @@ namespace Aleng
         {
             m_Index++;
             auto expr = Expression();
+            if (m_Panicking) return nullptr;
             if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::RPAREN)
             {
-                ReportError("Expected ')' after expression.", token.Range);
-                throw ParserSyncException();
+                return Fail("Expected ')' after expression.", RangeOf(token));
             }
             m_Index++;
             primaryExpr = std::move(expr);
@@ -844,8 +726,8 @@ namespace Aleng
         {
             m_Index++;
             NodePtr operand = Factor();
-            auto zero = std::make_unique<IntegerNode>(0, token.Range);
-            primaryExpr = std::make_unique<BinaryExpressionNode>(TokenType::MINUS, std::move(zero), std::move(operand), token.Range);
+            auto zero = std::make_unique<IntegerNode>(0, RangeOf(token));
+            primaryExpr = std::make_unique<BinaryExpressionNode>(TokenType::MINUS, std::move(zero), std::move(operand), RangeOf(token));
         }
         else if (token.Type == TokenType::FUNCTION)
         {
@@ -854,26 +736,26 @@ namespace Aleng
         else if (token.Type == TokenType::IDENTIFIER)
         {
             m_Index++;
-            primaryExpr = std::make_unique<IdentifierNode>(token.Value, token.Range);
+            primaryExpr = std::make_unique<IdentifierNode>(std::string(token.Value), RangeOf(token));
         }
         else if (token.Type == TokenType::IMPORT)
         {
             m_Index++;
             if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::STRING)
             {
-                auto strRange = m_Tokens[m_Index].Range;
-                auto pathStr = m_Tokens[m_Index++].Value;
-                return std::make_unique<ImportModuleNode>(pathStr, token.Range, strRange);
+                auto strRange = RangeOf(m_Tokens[m_Index]);
+                auto pathStr = Lexer::Unescape(m_Tokens[m_Index++].Value);
+                return std::make_unique<ImportModuleNode>(pathStr, RangeOf(token), strRange);
             }
-            ReportError("Expected module name string after 'Import'.", token.Range);
-            throw ParserSyncException();
+            return Fail("Expected module name string after 'Import'.", RangeOf(token));
         }
         else
         {
-            ReportError("Unexpected token: " + token.Value, token.Range);
-            throw ParserSyncException();
+            return Fail("Unexpected token: " + std::string(token.Value), RangeOf(token));
         }
 
+        if (m_Panicking) return nullptr;
+
         while (m_Index < m_Tokens.size())
         {
             if (m_Tokens[m_Index].Type == TokenType::LPAREN)
@@ -886,28 +768,27 @@ namespace Aleng
                 {
                     if (expectCommaArgs && m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::COMMA)
                     {
-                        ReportError("Expected ',' between function arguments.", token.Range);
-                        throw ParserSyncException();
+                        return Fail("Expected ',' between function arguments.", RangeOf(token));
                     }
                     if (expectCommaArgs)
                         m_Index++;
                     if (m_Tokens[m_Index].Type != TokenType::RPAREN)
-                        args.push_back(Expression());
+                    {
+                        auto arg = Expression();
+                        if (m_Panicking) return nullptr;
+                        args.push_back(std::move(arg));
+                    }
                     expectCommaArgs = true;
                 } while (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type == TokenType::COMMA);
 
                 if (m_Index < m_Tokens.size() && m_Tokens[m_Index].Type != TokenType::RPAREN)
                 {
-                    ReportError("Expected ')' after function arguments.", token.Range);
-                    throw ParserSyncException();
+                    return Fail("Expected ')' after function arguments.", RangeOf(token));
                 }
 
                 m_Index++;
 
-                SourceRange fullRange;
-                fullRange.Start = token.Range.Start;
-                fullRange.End = m_Tokens[m_Index - 1].Range.End;
-                fullRange.FilePath = token.Range.FilePath;
+                const SourceRange fullRange = RangeOf(token, m_Tokens[m_Index - 1]);
 
                 primaryExpr = std::make_unique<FunctionCallNode>(std::move(primaryExpr), std::move(args), fullRange);
             }
@@ -915,13 +796,13 @@ namespace Aleng
             {
                 m_Index++;
                 auto indexExpr = Expression();
+                if (m_Panicking) return nullptr;
                 if (m_Tokens[m_Index].Type != TokenType::RBRACE)
                 {
-                    ReportError("Expected ']' after list/map index expression.", token.Range);
-                    throw ParserSyncException();
+                    return Fail("Expected ']' after list/map index expression.", RangeOf(token));
                 }
                 m_Index++;
-                primaryExpr = std::make_unique<ListAccessNode>(std::move(primaryExpr), std::move(indexExpr), token.Range);
+                primaryExpr = std::make_unique<ListAccessNode>(std::move(primaryExpr), std::move(indexExpr), RangeOf(token));
             }
             else if (m_Tokens[m_Index].Type == TokenType::DOT)
             {
@@ -930,14 +811,13 @@ namespace Aleng
 
                 if (m_Index >= m_Tokens.size() || m_Tokens[m_Index].Type != TokenType::IDENTIFIER)
                 {
-                    ReportError("Expected member name after '.'", token.Range);
-                    throw ParserSyncException();
+                    return Fail("Expected member name after '.'", RangeOf(token));
                 }
 
                 Token memberToken = m_Tokens[m_Index];
                 m_Index++;
 
-                primaryExpr = std::make_unique<MemberAccessNode>(std::move(primaryExpr), memberToken, dotToken.Range);
+                primaryExpr = std::make_unique<MemberAccessNode>(std::move(primaryExpr), std::string(memberToken.Value), RangeOf(dotToken));
             }
             else
                 break;
@@ -950,7 +830,7 @@ namespace Aleng
     {
         if (m_Index + 1 < m_Tokens.size())
             return m_Tokens[m_Index + 1];
-        return {TokenType::END_OF_FILE, "", m_Tokens[m_Index].Range};
+        return {TokenType::END_OF_FILE, "", m_Tokens[m_Index].Offset, 0};
     }
 
     void Parser::ReportError(const std::string &msg, SourceRange loc)
@@ -958,6 +838,25 @@ namespace Aleng
         m_Errors.emplace_back(msg, loc);
     }
 
+    NodePtr Parser::Fail(const std::string &msg, SourceRange loc)
+    {
+        ReportError(msg, std::move(loc));
+        m_Panicking = true;
+        return nullptr;
+    }
+
+    void Parser::ParseStatementInto(std::vector<NodePtr> &statements)
+    {
+        if (auto stmt = Statement())
+            statements.push_back(std::move(stmt));
+
+        if (m_Panicking)
+        {
+            m_Panicking = false;
+            Synchronize();
+        }
+    }
+
     void Parser::Synchronize()
     {
         m_Index++;
@@ -9,7 +9,9 @@ namespace Aleng
     class Parser
     {
     public:
-        explicit Parser(const std::string &input, std::string filepath = "unknown");
+        explicit Parser(const std::string &input, const std::string &filepath = "unknown");
+        Parser(const Parser &) = delete;
+        Parser &operator=(const Parser &) = delete;
         std::unique_ptr<ProgramNode> ParseProgram();
 
         [[nodiscard]] const std::vector<AlengError>& GetErrors() const { return m_Errors; }
@@ -27,21 +29,25 @@ namespace Aleng
         NodePtr ParseMapLiteral();
 
         NodePtr Expression();
-        NodePtr LogicalOrExpression();
-        NodePtr LogicalAndExpression();
-        NodePtr EqualityExpression();
-        NodePtr ComparisonExpression();
-        NodePtr AddictiveExpression();
-        NodePtr Term();
+        // Precedence climbing over the binary operators that bind at least as tightly as minPrecedence.
+        NodePtr BinaryExpression(int minPrecedence);
         NodePtr UnaryExpression();
         NodePtr Factor();
 
         Token Peek();
+        [[nodiscard]] SourceRange RangeOf(const Token &token) const { return m_Lexer.RangeOf(token, token); }
+        [[nodiscard]] SourceRange RangeOf(const Token &first, const Token &last) const { return m_Lexer.RangeOf(first, last); }
         void ReportError(const std::string& msg, SourceRange loc);
+        // Records a syntax error and enters panic mode: every production returns null
+        // until the enclosing statement loop resynchronizes.
+        NodePtr Fail(const std::string &msg, SourceRange loc);
+        void ParseStatementInto(std::vector<NodePtr> &statements);
         void Synchronize();
 
     private:
         int m_Index = 0;
+        bool m_Panicking = false;
+        Lexer m_Lexer; // owns the source the tokens point into
         std::vector<Token> m_Tokens;
         std::vector<AlengError> m_Errors;
     };
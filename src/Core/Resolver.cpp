@@ -0,0 +1,357 @@
+#include "Resolver.h"
+
+#include "Error.h"
+
+namespace Aleng
+{
+    void Resolver::Resolve(ProgramNode &program)
+    {
+        Resolver resolver;
+        resolver.m_Functions.emplace_back();
+
+        for (const auto &stmt : program.Statements)
+            resolver.Resolve(*stmt);
+
+        resolver.Finalize(program);
+    }
+
+    void Resolver::Resolve(ASTNode &node)
+    {
+        if (const auto id = NodeCast<IdentifierNode>(&node))
+            Reference(id->Value, id->Binding);
+        else if (const auto block = NodeCast<BlockNode>(&node))
+        {
+            for (const auto &stmt : block->Statements)
+                Resolve(*stmt);
+        }
+        else if (const auto ifNode = NodeCast<IfNode>(&node))
+        {
+            Resolve(*ifNode->Condition);
+            Resolve(*ifNode->ThenBranch);
+            if (ifNode->ElseBranch)
+                Resolve(*ifNode->ElseBranch);
+        }
+        else if (const auto forNode = NodeCast<ForStatementNode>(&node))
+            ResolveFor(*forNode);
+        else if (const auto whileNode = NodeCast<WhileStatementNode>(&node))
+            ResolveWhile(*whileNode);
+        else if (const auto function = NodeCast<FunctionDefinitionNode>(&node))
+            ResolveFunction(*function);
+        else if (const auto ret = NodeCast<ReturnNode>(&node))
+        {
+            if (ret->ReturnValueExpression)
+                Resolve(*ret->ReturnValueExpression);
+        }
+        else if (const auto assign = NodeCast<AssignExpressionNode>(&node))
+        {
+            Resolve(*assign->Right);
+            Resolve(*assign->Left);
+        }
+        else if (const auto call = NodeCast<FunctionCallNode>(&node))
+        {
+            Resolve(*call->CallableExpression);
+            for (const auto &arg : call->Arguments)
+                Resolve(*arg);
+        }
+        else if (const auto binary = NodeCast<BinaryExpressionNode>(&node))
+        {
+            Resolve(*binary->Left);
+            Resolve(*binary->Right);
+        }
+        else if (const auto equals = NodeCast<EqualsExpressionNode>(&node))
+        {
+            Resolve(*equals->Left);
+            Resolve(*equals->Right);
+        }
+        else if (const auto unary = NodeCast<UnaryExpressionNode>(&node))
+            Resolve(*unary->Right);
+        else if (const auto member = NodeCast<MemberAccessNode>(&node))
+            Resolve(*member->Object);
+        else if (const auto access = NodeCast<ListAccessNode>(&node))
+        {
+            Resolve(*access->Object);
+            Resolve(*access->Index);
+        }
+        else if (const auto list = NodeCast<ListNode>(&node))
+        {
+            for (const auto &element : list->Elements)
+                Resolve(*element);
+        }
+        else if (const auto map = NodeCast<MapNode>(&node))
+        {
+            for (const auto &[key, value] : map->Elements)
+            {
+                Resolve(*key);
+                Resolve(*value);
+            }
+        }
+    }
+
+    void Resolver::ResolveFunction(FunctionDefinitionNode &node)
+    {
+        node.NameBinding = {};
+        if (node.FunctionName && !m_Scopes.empty())
+            m_References.emplace_back(&node.NameBinding, Declare(*node.FunctionName));
+
+        const int enclosing = m_CurrentFunction;
+        m_Functions.push_back({enclosing, &node, {}, {}});
+        m_CurrentFunction = static_cast<int>(m_Functions.size()) - 1;
+        m_Scopes.push_back({{}, m_CurrentFunction});
+
+        node.ParameterBindings.assign(node.Parameters.size(), {});
+        for (size_t i = 0; i < node.Parameters.size(); i++)
+        {
+            const auto &param = node.Parameters[i];
+            if (m_Scopes.back().Names.contains(param.Name))
+                throw AlengError("Parameter '" + param.Name + "' is declared more than once.", param.Range);
+            m_References.emplace_back(&node.ParameterBindings[i], Declare(param.Name));
+        }
+
+        DeclareAssignments(*node.Body);
+        Resolve(*node.Body);
+
+        m_Scopes.pop_back();
+        m_CurrentFunction = enclosing;
+    }
+
+    void Resolver::ResolveFor(ForStatementNode &node)
+    {
+        m_Scopes.push_back({{}, m_CurrentFunction});
+        const size_t firstVariable = m_Functions[m_CurrentFunction].Variables.size();
+
+        if (node.Type == ForStatementNode::LoopType::NUMERIC && node.NumericLoopInfo)
+        {
+            auto &info = *node.NumericLoopInfo;
+            m_References.emplace_back(&node.IteratorBinding, Declare(info.IteratorVariableName));
+
+            DeclareAssignments(*info.StartExpression);
+            DeclareAssignments(*info.EndExpression);
+            if (info.StepExpression)
+                DeclareAssignments(*info.StepExpression);
+            DeclareAssignments(*node.Body);
+
+            Resolve(*info.StartExpression);
+            Resolve(*info.EndExpression);
+            if (info.StepExpression)
+                Resolve(*info.StepExpression);
+        }
+        else if (node.Type == ForStatementNode::LoopType::COLLECTION && node.CollectionLoopInfo)
+        {
+            auto &info = *node.CollectionLoopInfo;
+            m_References.emplace_back(&node.IteratorBinding, Declare(info.IteratorVariableName));
+
+            DeclareAssignments(*info.CollectionExpression);
+            DeclareAssignments(*node.Body);
+
+            Resolve(*info.CollectionExpression);
+        }
+
+        Resolve(*node.Body);
+
+        m_Loops.push_back({&node.Scope, m_CurrentFunction, firstVariable, m_Functions[m_CurrentFunction].Variables.size()});
+        m_Scopes.pop_back();
+    }
+
+    void Resolver::ResolveWhile(WhileStatementNode &node)
+    {
+        m_Scopes.push_back({{}, m_CurrentFunction});
+        const size_t firstVariable = m_Functions[m_CurrentFunction].Variables.size();
+
+        DeclareAssignments(*node.Condition);
+        DeclareAssignments(*node.Body);
+
+        Resolve(*node.Condition);
+        Resolve(*node.Body);
+
+        m_Loops.push_back({&node.Scope, m_CurrentFunction, firstVariable, m_Functions[m_CurrentFunction].Variables.size()});
+        m_Scopes.pop_back();
+    }
+
+    void Resolver::DeclareAssignments(ASTNode &node)
+    {
+        if (const auto assign = NodeCast<AssignExpressionNode>(&node))
+        {
+            if (const auto id = NodeCast<IdentifierNode>(assign->Left.get()))
+            {
+                if (!IsDeclaredInEnclosingScope(id->Value))
+                    Declare(id->Value);
+            }
+            else
+                DeclareAssignments(*assign->Left);
+            DeclareAssignments(*assign->Right);
+        }
+        else if (const auto function = NodeCast<FunctionDefinitionNode>(&node))
+        {
+            // Named functions always bind in the scope they appear in; bodies get their own frame.
+            if (function->FunctionName)
+                Declare(*function->FunctionName);
+        }
+        else if (const auto block = NodeCast<BlockNode>(&node))
+        {
+            for (const auto &stmt : block->Statements)
+                DeclareAssignments(*stmt);
+        }
+        else if (const auto ifNode = NodeCast<IfNode>(&node))
+        {
+            DeclareAssignments(*ifNode->Condition);
+            DeclareAssignments(*ifNode->ThenBranch);
+            if (ifNode->ElseBranch)
+                DeclareAssignments(*ifNode->ElseBranch);
+        }
+        else if (const auto ret = NodeCast<ReturnNode>(&node))
+        {
+            if (ret->ReturnValueExpression)
+                DeclareAssignments(*ret->ReturnValueExpression);
+        }
+        else if (const auto call = NodeCast<FunctionCallNode>(&node))
+        {
+            DeclareAssignments(*call->CallableExpression);
+            for (const auto &arg : call->Arguments)
+                DeclareAssignments(*arg);
+        }
+        else if (const auto binary = NodeCast<BinaryExpressionNode>(&node))
+        {
+            DeclareAssignments(*binary->Left);
+            DeclareAssignments(*binary->Right);
+        }
+        else if (const auto equals = NodeCast<EqualsExpressionNode>(&node))
+        {
+            DeclareAssignments(*equals->Left);
+            DeclareAssignments(*equals->Right);
+        }
+        else if (const auto unary = NodeCast<UnaryExpressionNode>(&node))
+            DeclareAssignments(*unary->Right);
+        else if (const auto member = NodeCast<MemberAccessNode>(&node))
+            DeclareAssignments(*member->Object);
+        else if (const auto access = NodeCast<ListAccessNode>(&node))
+        {
+            DeclareAssignments(*access->Object);
+            DeclareAssignments(*access->Index);
+        }
+        else if (const auto list = NodeCast<ListNode>(&node))
+        {
+            for (const auto &element : list->Elements)
+                DeclareAssignments(*element);
+        }
+        else if (const auto map = NodeCast<MapNode>(&node))
+        {
+            for (const auto &[key, value] : map->Elements)
+            {
+                DeclareAssignments(*key);
+                DeclareAssignments(*value);
+            }
+        }
+    }
+
+    bool Resolver::IsDeclaredInEnclosingScope(const std::string &name) const
+    {
+        for (const auto &scope : m_Scopes)
+            if (scope.Names.contains(name))
+                return true;
+        return false;
+    }
+
+    Resolver::Variable *Resolver::Declare(const std::string &name)
+    {
+        auto &scope = m_Scopes.back();
+        if (const auto it = scope.Names.find(name); it != scope.Names.end())
+            return it->second;
+
+        auto *variable = &m_Variables.emplace_back();
+        scope.Names.emplace(name, variable);
+        m_Functions[scope.Function].Variables.push_back(variable);
+        return variable;
+    }
+
+    void Resolver::Reference(const std::string &name, VariableBinding &binding)
+    {
+        for (int i = static_cast<int>(m_Scopes.size()) - 1; i >= 0; i--)
+        {
+            const auto it = m_Scopes[i].Names.find(name);
+            if (it == m_Scopes[i].Names.end())
+                continue;
+
+            if (m_Scopes[i].Function == m_CurrentFunction)
+                m_References.emplace_back(&binding, it->second);
+            else
+            {
+                it->second->Captured = true;
+                binding = {BindingKind::UPVALUE, AddUpvalue(m_CurrentFunction, it->second, m_Scopes[i].Function)};
+            }
+            return;
+        }
+        binding = {};
+    }
+
+    int Resolver::AddUpvalue(const int function, Variable *target, const int owner)
+    {
+        auto &upvalues = m_Functions[function].Upvalues;
+        for (size_t i = 0; i < upvalues.size(); i++)
+        {
+            if (upvalues[i].Target == target)
+                return static_cast<int>(i);
+        }
+
+        // Functions between the owner and the user capture the variable too, so it can be handed down.
+        Upvalue upvalue{target};
+        if (const int parent = m_Functions[function].Parent; parent != owner)
+        {
+            upvalue.FromEnclosingCell = false;
+            upvalue.EnclosingIndex = AddUpvalue(parent, target, owner);
+        }
+
+        m_Functions[function].Upvalues.push_back(upvalue);
+        return static_cast<int>(m_Functions[function].Upvalues.size()) - 1;
+    }
+
+    void Resolver::Finalize(ProgramNode &program)
+    {
+        for (auto &function : m_Functions)
+        {
+            int locals = 0;
+            int cells = 0;
+            for (auto *variable : function.Variables)
+                variable->Index = variable->Captured ? cells++ : locals++;
+
+            if (!function.Node)
+            {
+                program.LocalCount = locals;
+                program.CellCount = cells;
+                continue;
+            }
+
+            function.Node->LocalCount = locals;
+            function.Node->CellCount = cells;
+            function.Node->Captures.clear();
+            for (const auto &upvalue : function.Upvalues)
+            {
+                const int index = upvalue.FromEnclosingCell ? upvalue.Target->Index : upvalue.EnclosingIndex;
+                function.Node->Captures.push_back({upvalue.FromEnclosingCell, index});
+            }
+        }
+
+        for (const auto &[binding, variable] : m_References)
+            *binding = {variable->Captured ? BindingKind::CELL : BindingKind::LOCAL, variable->Index};
+
+        for (const auto &loop : m_Loops)
+        {
+            const auto &variables = m_Functions[loop.Function].Variables;
+            ScopeRange range;
+            for (size_t i = 0; i < loop.EndVariable; i++)
+            {
+                const bool inLoop = i >= loop.FirstVariable;
+                if (variables[i]->Captured)
+                {
+                    range.CellStart += inLoop ? 0 : 1;
+                    range.CellEnd++;
+                }
+                else
+                {
+                    range.LocalStart += inLoop ? 0 : 1;
+                    range.LocalEnd++;
+                }
+            }
+            *loop.Range = range;
+        }
+    }
+}
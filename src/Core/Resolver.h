@@ -0,0 +1,81 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AST.h"
+
+namespace Aleng
+{
+    // Assigns storage to every local variable before a program runs.
+    // Function calls and loops open a scope; names assigned inside them belong to the innermost
+    // such scope unless an enclosing one already declares them. Program and module level names stay global.
+    // Each function gets one flat frame: plain locals get a slot, locals captured by an inner function
+    // get a cell, and the inner function records which cells it captures as upvalues.
+    class Resolver
+    {
+    public:
+        static void Resolve(ProgramNode &program);
+
+    private:
+        struct Variable
+        {
+            bool Captured = false;
+            int Index = -1;
+        };
+
+        struct Upvalue
+        {
+            Variable *Target = nullptr;
+            bool FromEnclosingCell = true;
+            int EnclosingIndex = -1;
+        };
+
+        struct FunctionInfo
+        {
+            int Parent = -1;
+            FunctionDefinitionNode *Node = nullptr; // null for the program itself
+            std::vector<Variable *> Variables;     // in declaration order
+            std::vector<Upvalue> Upvalues;
+        };
+
+        struct Scope
+        {
+            std::unordered_map<std::string, Variable *> Names;
+            int Function = 0;
+        };
+
+        struct LoopInfo
+        {
+            ScopeRange *Range = nullptr;
+            int Function = 0;
+            size_t FirstVariable = 0;
+            size_t EndVariable = 0;
+        };
+
+        void Resolve(ASTNode &node);
+        void ResolveFunction(FunctionDefinitionNode &node);
+        void ResolveFor(ForStatementNode &node);
+        void ResolveWhile(WhileStatementNode &node);
+
+        // Declares every name assigned at this scope level, so reads see it regardless of textual order.
+        void DeclareAssignments(ASTNode &node);
+        [[nodiscard]] bool IsDeclaredInEnclosingScope(const std::string &name) const;
+
+        Variable *Declare(const std::string &name);
+        void Reference(const std::string &name, VariableBinding &binding);
+        int AddUpvalue(int function, Variable *target, int owner);
+        void Finalize(ProgramNode &program);
+
+    private:
+        std::deque<Variable> m_Variables;
+        std::vector<FunctionInfo> m_Functions;
+        std::vector<Scope> m_Scopes;
+        std::vector<LoopInfo> m_Loops;
+        std::vector<std::pair<VariableBinding *, Variable *>> m_References;
+        int m_CurrentFunction = 0;
+    };
+}
@@ -0,0 +1,94 @@
+#include "SourceManager.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace Aleng
+{
+    namespace
+    {
+        struct SourceFile
+        {
+            std::string Path;
+            std::weak_ptr<const SourceText> Source;
+        };
+
+        // Paths stay for the whole run, since ranges refer to them by id; the text does not.
+        struct FileTable
+        {
+            std::mutex Mutex;
+            std::deque<SourceFile> Files{SourceFile{}};
+            std::unordered_map<std::string_view, FileId> Ids{{std::string_view(), 0}};
+        };
+
+        FileTable &Table()
+        {
+            static FileTable table;
+            return table;
+        }
+    }
+
+    SourceText::SourceText(std::string text) : m_Text(std::move(text)), m_LineStarts{0}
+    {
+        for (size_t i = 0; i < m_Text.length(); i++)
+            if (m_Text[i] == '\n')
+                m_LineStarts.push_back(static_cast<uint32_t>(i + 1));
+    }
+
+    std::optional<std::string_view> SourceText::GetLine(const int line) const
+    {
+        if (line < 1 || line > static_cast<int>(m_LineStarts.size()))
+            return std::nullopt;
+
+        const std::string_view source = m_Text;
+        const size_t start = m_LineStarts[line - 1];
+        size_t end = line < static_cast<int>(m_LineStarts.size()) ? m_LineStarts[line] - 1 : source.length();
+        if (end > start && source[end - 1] == '\r')
+            end--;
+        return source.substr(start, end - start);
+    }
+
+    FileId SourceManager::AddFile(const std::string_view path)
+    {
+        auto &table = Table();
+        std::lock_guard lock(table.Mutex);
+        if (const auto it = table.Ids.find(path); it != table.Ids.end())
+            return it->second;
+
+        const auto id = static_cast<FileId>(table.Files.size());
+        // Deque elements never move, so the key can view the stored path.
+        const auto &file = table.Files.emplace_back(SourceFile{std::string(path), {}});
+        table.Ids.emplace(file.Path, id);
+        return id;
+    }
+
+    const std::string &SourceManager::GetPath(const FileId file)
+    {
+        auto &table = Table();
+        std::lock_guard lock(table.Mutex);
+        // The path itself is never written again, so it can be read after the lock is released.
+        return table.Files[file < table.Files.size() ? file : 0].Path;
+    }
+
+    std::shared_ptr<const SourceText> SourceManager::SetSource(const FileId file, std::string source)
+    {
+        auto text = std::make_shared<const SourceText>(std::move(source));
+        auto &table = Table();
+        std::lock_guard lock(table.Mutex);
+        table.Files.at(file).Source = text;
+        return text;
+    }
+
+    std::shared_ptr<const SourceText> SourceManager::GetSource(const FileId file)
+    {
+        auto &table = Table();
+        std::lock_guard lock(table.Mutex);
+        return file < table.Files.size() ? table.Files[file].Source.lock() : nullptr;
+    }
+
+    const std::string &SourceRange::FilePath() const
+    {
+        return SourceManager::GetPath(File);
+    }
+}
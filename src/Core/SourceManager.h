@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SourceRange.h"
+
+namespace Aleng
+{
+    // Text of one file and the offset of each of its lines. It never changes once built, so any thread
+    // may read it.
+    class SourceText
+    {
+    public:
+        explicit SourceText(std::string text);
+
+        [[nodiscard]] const std::string &Text() const { return m_Text; }
+        // Text of a 1-based line without its line break.
+        [[nodiscard]] std::optional<std::string_view> GetLine(int line) const;
+
+    private:
+        std::string m_Text;
+        std::vector<uint32_t> m_LineStarts;
+    };
+
+    // Table of every file the lexer has read. Ranges name their file by id instead of carrying
+    // the path, and error reports look source lines up through a line-offset index. Safe to use from
+    // any thread.
+    class SourceManager
+    {
+    public:
+        // Returns the id of path, registering it on first use. Id 0 is the unnamed file.
+        static FileId AddFile(std::string_view path);
+        [[nodiscard]] static const std::string &GetPath(FileId file);
+
+        // Replaces the text kept for a file. The table only holds it weakly: the lexer, the tree parsed
+        // from it and the errors raised in it keep it alive, and it is freed with the last of them.
+        static std::shared_ptr<const SourceText> SetSource(FileId file, std::string source);
+        // The file's latest text, if something still holds it.
+        [[nodiscard]] static std::shared_ptr<const SourceText> GetSource(FileId file);
+    };
+}
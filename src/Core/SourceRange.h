@@ -1,8 +1,12 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
 namespace Aleng {
 
+    // Index into the SourceManager's file table.
+    using FileId = uint32_t;
+
     struct SourceLocation {
         int Line = 0;
         int Column = 0;
@@ -11,7 +15,10 @@ namespace Aleng {
     struct SourceRange {
         SourceLocation Start;
         SourceLocation End;
-        std::string FilePath;
+        FileId File = 0;
+
+        // Path of the file this range belongs to, looked up in the SourceManager.
+        [[nodiscard]] const std::string &FilePath() const;
 
         bool Contains(const int line, const int column) const {
             if (line < Start.Line || line > End.Line) return false;
@@ -20,4 +27,4 @@ namespace Aleng {
             return true;
         }
     };
-}
\ No newline at end of file
+}
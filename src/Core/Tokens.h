@@ -1,7 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <utility>
+#include <string_view>
 
 #include "SourceRange.h"
 
@@ -65,16 +66,17 @@ namespace Aleng
         END_OF_FILE // EOF
     };
 
+    // Tokens point into the source buffer owned by the Lexer that produced them.
+    // Lines and columns are looked up from the byte offset only when a range is needed.
     struct Token
     {
-        Token(const TokenType type, const char c, SourceRange range)
-            : Type(type), Value(std::string(1, c)), Range(std::move(range)) { }
-        Token(const TokenType type, std::string str, SourceRange range)
-            : Type(type), Value(std::move(str)), Range(std::move(range)) { }
+        Token(const TokenType type, const std::string_view value, const uint32_t offset, const uint32_t length)
+            : Type(type), Value(value), Offset(offset), Length(length) { }
 
         TokenType Type;
-        std::string Value;
-        SourceRange Range;
+        std::string_view Value; // for strings, the raw text between the quotes
+        uint32_t Offset;        // byte offset of the whole lexeme
+        uint32_t Length;
     };
 
     inline std::string TokenTypeToString(const TokenType type)
@@ -0,0 +1,521 @@
+#include "VM.h"
+
+#include <cmath>
+#include <ranges>
+#include <sstream>
+
+#include "Compiler.h"
+#include "Error.h"
+#include "Visitor.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define ALENG_COMPUTED_GOTO 1
+#endif
+
+namespace Aleng
+{
+    namespace
+    {
+        // Restores the value stack when a chunk exits, normally or by exception.
+        struct FrameGuard
+        {
+            std::vector<EvaluatedValue> &Stack;
+            size_t StackBase;
+
+            ~FrameGuard()
+            {
+                if (Stack.size() > StackBase)
+                    Stack.erase(Stack.begin() + static_cast<std::ptrdiff_t>(StackBase), Stack.end());
+            }
+        };
+    }
+
+    VM::VM(Visitor &visitor)
+        : m_Visitor(visitor)
+    {
+    }
+
+    EvaluatedValue VM::Execute(const ProgramNode &program)
+    {
+        const auto chunk = Compiler::CompileProgram(program);
+        return Run(*chunk);
+    }
+
+    EvaluatedValue VM::Execute(const FunctionObject &function)
+    {
+        const auto &definition = *function.UserFuncNodeAst;
+        if (!definition.CompiledBody)
+            definition.CompiledBody = Compiler::CompileFunction(definition);
+
+        const auto chunk = definition.CompiledBody;
+        return Run(*chunk);
+    }
+
+    EvaluatedValue VM::Run(const Chunk &chunk)
+    {
+        FrameGuard guard{m_Stack, m_Stack.size()};
+
+        auto &stack = m_Stack;
+        const Instruction *code = chunk.Code.data();
+        const Instruction *ip = code;
+        const Instruction *instruction = nullptr;
+
+        #define NODE() (*chunk.Nodes[instruction - code])
+        #define NODE_AS(type) static_cast<const type &>(NODE())
+        #define TOP() stack.back()
+        #define PEEK(distance) stack[stack.size() - 1 - (distance)]
+
+        // Replaces the two operands with the result.
+        #define BINARY_RESULT(value)                                                     \
+            {                                                                            \
+                EvaluatedValue result = (value);                                         \
+                stack.pop_back();                                                        \
+                TOP() = std::move(result);                                               \
+                DISPATCH();                                                              \
+            }
+
+        // Comparisons on two numbers skip the generic dispatch; integers are compared exactly.
+        #define BINARY_OP(tokenType, expression)                                         \
+            {                                                                            \
+                if (PEEK(1).IsDouble() && PEEK(0).IsDouble())                            \
+                {                                                                        \
+                    const double l = PEEK(1).AsDouble();                                 \
+                    const double r = PEEK(0).AsDouble();                                 \
+                    BINARY_RESULT(expression);                                           \
+                }                                                                        \
+                if (PEEK(1).IsInteger() && PEEK(0).IsInteger())                          \
+                {                                                                        \
+                    const int64_t l = PEEK(1).AsInteger();                               \
+                    const int64_t r = PEEK(0).AsInteger();                               \
+                    BINARY_RESULT(expression);                                           \
+                }                                                                        \
+                if (PEEK(1).IsNumber() && PEEK(0).IsNumber())                            \
+                {                                                                        \
+                    const double l = PEEK(1).AsNumber();                                 \
+                    const double r = PEEK(0).AsNumber();                                 \
+                    BINARY_RESULT(expression);                                           \
+                }                                                                        \
+                BINARY_RESULT(Visitor::BinaryOperation(tokenType, PEEK(1), PEEK(0), NODE())); \
+            }
+
+        // Arithmetic on two integers stays in integers unless it overflows, then it is done in doubles.
+        #define ARITHMETIC_OP(tokenType, checkedOperation, expression)                   \
+            {                                                                            \
+                if (PEEK(1).IsDouble() && PEEK(0).IsDouble())                            \
+                {                                                                        \
+                    const double l = PEEK(1).AsDouble();                                 \
+                    const double r = PEEK(0).AsDouble();                                 \
+                    BINARY_RESULT(expression);                                           \
+                }                                                                        \
+                if (PEEK(1).IsInteger() && PEEK(0).IsInteger())                          \
+                {                                                                        \
+                    int64_t integer;                                                     \
+                    if (!checkedOperation(PEEK(1).AsInteger(), PEEK(0).AsInteger(), integer)) \
+                        BINARY_RESULT(integer);                                          \
+                }                                                                        \
+                if (PEEK(1).IsNumber() && PEEK(0).IsNumber())                            \
+                {                                                                        \
+                    const double l = PEEK(1).AsNumber();                                 \
+                    const double r = PEEK(0).AsNumber();                                 \
+                    BINARY_RESULT(expression);                                           \
+                }                                                                        \
+                BINARY_RESULT(Visitor::BinaryOperation(tokenType, PEEK(1), PEEK(0), NODE())); \
+            }
+
+        // A computed goto leaves the handler without running destructors, so a handler that owns
+        // values keeps them in an inner block that closes before DISPATCH.
+        #ifdef ALENG_COMPUTED_GOTO
+            static const void *dispatchTable[] = {
+                #define ALENG_OPCODE_LABEL(name) &&op_##name,
+                ALENG_OPCODES(ALENG_OPCODE_LABEL)
+                #undef ALENG_OPCODE_LABEL
+            };
+            #define DISPATCH()                                                       \
+                do                                                                   \
+                {                                                                    \
+                    instruction = ip++;                                              \
+                    goto *dispatchTable[static_cast<uint8_t>(instruction->Op)];      \
+                } while (0)
+            #define CASE(name) op_##name:
+
+            DISPATCH();
+        #else
+            #define DISPATCH() break
+            #define CASE(name) case OpCode::name:
+
+            while (true)
+            {
+                instruction = ip++;
+                switch (instruction->Op)
+                {
+        #endif
+
+        CASE(CONSTANT)
+        {
+            stack.push_back(chunk.Constants[instruction->A]);
+            DISPATCH();
+        }
+        CASE(POP)
+        {
+            stack.pop_back();
+            DISPATCH();
+        }
+        // Empty storage has not been assigned yet; the Visitor then falls back to globals by name.
+        #define LOAD_FROM(storage)                                                       \
+            {                                                                            \
+                if (const auto &value = (storage))                                       \
+                    stack.push_back(*value);                                             \
+                else                                                                     \
+                    stack.push_back(m_Visitor.LookupIdentifier(NODE_AS(IdentifierNode))); \
+                DISPATCH();                                                              \
+            }
+        #define STORE_TO(storage)                                                        \
+            {                                                                            \
+                if (auto &value = (storage))                                             \
+                    *value = TOP();                                                      \
+                else                                                                     \
+                    m_Visitor.AssignIdentifier(NODE_AS(IdentifierNode), TOP());          \
+                DISPATCH();                                                              \
+            }
+
+        CASE(LOAD_LOCAL) LOAD_FROM(m_Visitor.m_Locals[m_Visitor.m_LocalBase + instruction->A])
+        CASE(STORE_LOCAL) STORE_TO(m_Visitor.m_Locals[m_Visitor.m_LocalBase + instruction->A])
+        CASE(LOAD_CELL) LOAD_FROM(m_Visitor.m_Cells[m_Visitor.m_CellBase + instruction->A]->Value)
+        CASE(STORE_CELL) STORE_TO(m_Visitor.m_Cells[m_Visitor.m_CellBase + instruction->A]->Value)
+        CASE(LOAD_UPVALUE) LOAD_FROM((*m_Visitor.m_Upvalues)[instruction->A]->Value)
+        CASE(STORE_UPVALUE) STORE_TO((*m_Visitor.m_Upvalues)[instruction->A]->Value)
+        CASE(LOAD_GLOBAL)
+        {
+            stack.push_back(m_Visitor.LookupIdentifier(NODE_AS(IdentifierNode)));
+            DISPATCH();
+        }
+        CASE(STORE_GLOBAL)
+        {
+            m_Visitor.AssignVariable(chunk.Names[instruction->A], TOP(), NODE());
+            DISPATCH();
+        }
+        CASE(GET_INDEX)
+        {
+            // In-range reads from a list skip the generic lookup and its error reporting.
+            if (PEEK(1).IsList() && PEEK(0).IsInteger())
+            {
+                const auto &elements = PEEK(1).AsList().elements;
+                if (const int64_t index = PEEK(0).AsInteger(); index >= 0 && index < static_cast<int64_t>(elements.size()))
+                {
+                    EvaluatedValue result = elements[static_cast<size_t>(index)];
+                    stack.pop_back();
+                    TOP() = std::move(result);
+                    DISPATCH();
+                }
+            }
+            auto result = Visitor::GetIndex(PEEK(1), PEEK(0), NODE_AS(ListAccessNode));
+            stack.pop_back();
+            TOP() = std::move(result);
+            DISPATCH();
+        }
+        CASE(SET_INDEX)
+        {
+            if (PEEK(1).IsList() && PEEK(0).IsInteger())
+            {
+                auto &elements = PEEK(1).AsList().elements;
+                if (const int64_t index = PEEK(0).AsInteger(); index >= 0 && index < static_cast<int64_t>(elements.size()))
+                {
+                    elements[static_cast<size_t>(index)] = PEEK(2);
+                    stack.pop_back();
+                    stack.pop_back();
+                    DISPATCH();
+                }
+            }
+            Visitor::AssignIndex(PEEK(1), PEEK(0), PEEK(2), NODE_AS(AssignExpressionNode));
+            stack.pop_back();
+            stack.pop_back();
+            DISPATCH();
+        }
+        CASE(GET_MEMBER)
+        {
+            TOP() = Visitor::GetMember(TOP(), NODE_AS(MemberAccessNode));
+            DISPATCH();
+        }
+        CASE(SET_MEMBER)
+        {
+            Visitor::AssignMember(PEEK(0), PEEK(1), NODE_AS(AssignExpressionNode));
+            stack.pop_back();
+            DISPATCH();
+        }
+        CASE(ADD) ARITHMETIC_OP(TokenType::PLUS, AddOverflows, l + r)
+        CASE(SUBTRACT) ARITHMETIC_OP(TokenType::MINUS, SubtractOverflows, l - r)
+        CASE(MULTIPLY) ARITHMETIC_OP(TokenType::MULTIPLY, MultiplyOverflows, l * r)
+        CASE(DIVIDE)
+        {
+            if (PEEK(0).IsInteger() && PEEK(1).IsInteger())
+            {
+                const int64_t l = PEEK(1).AsInteger();
+                const int64_t r = PEEK(0).AsInteger();
+                // Same rules as Visitor::BinaryOperation, which also handles -1, where INT64_MIN / -1 overflows.
+                if (r != 0 && r != -1 && l % r == 0)
+                    BINARY_RESULT(l / r);
+                if (r == -1)
+                    BINARY_RESULT(Visitor::BinaryOperation(TokenType::DIVIDE, PEEK(1), PEEK(0), NODE()));
+            }
+            if (PEEK(0).IsNumber() && PEEK(1).IsNumber() && PEEK(0).AsNumber() != 0.0)
+                BINARY_RESULT(PEEK(1).AsNumber() / PEEK(0).AsNumber());
+            BINARY_RESULT(Visitor::BinaryOperation(TokenType::DIVIDE, PEEK(1), PEEK(0), NODE()));
+        }
+        CASE(MODULO)
+        {
+            if (PEEK(0).IsInteger() && PEEK(1).IsInteger() && PEEK(0).AsInteger() != 0)
+            {
+                const int64_t r = PEEK(0).AsInteger();
+                BINARY_RESULT(r == -1 ? int64_t{0} : PEEK(1).AsInteger() % r);
+            }
+            if (PEEK(0).IsNumber() && PEEK(1).IsNumber() && PEEK(0).AsNumber() != 0.0)
+                BINARY_RESULT(std::fmod(PEEK(1).AsNumber(), PEEK(0).AsNumber()));
+            BINARY_RESULT(Visitor::BinaryOperation(TokenType::MODULO, PEEK(1), PEEK(0), NODE()));
+        }
+        CASE(GREATER) BINARY_OP(TokenType::GREATER, l > r)
+        CASE(GREATER_EQUAL) BINARY_OP(TokenType::GREATER_EQUAL, l >= r)
+        CASE(LESS) BINARY_OP(TokenType::MINOR, l < r)
+        CASE(LESS_EQUAL) BINARY_OP(TokenType::MINOR_EQUAL, l <= r)
+        CASE(EQUAL)
+        {
+            const bool result = Visitor::AreEqual(PEEK(1), PEEK(0), NODE());
+            stack.pop_back();
+            TOP() = result;
+            DISPATCH();
+        }
+        CASE(NOT_EQUAL)
+        {
+            const bool result = !Visitor::AreEqual(PEEK(1), PEEK(0), NODE());
+            stack.pop_back();
+            TOP() = result;
+            DISPATCH();
+        }
+        CASE(NOT)
+        {
+            TOP() = !IsTruthy(TOP());
+            DISPATCH();
+        }
+        CASE(TRUTHY)
+        {
+            TOP() = IsTruthy(TOP());
+            DISPATCH();
+        }
+        CASE(JUMP)
+        {
+            ip = code + instruction->A;
+            DISPATCH();
+        }
+        CASE(LOOP)
+        {
+            m_Visitor.ConsumeStep(NODE());
+            ip = code + instruction->A;
+            DISPATCH();
+        }
+        CASE(JUMP_IF_FALSE)
+        {
+            const bool condition = IsTruthy(TOP());
+            stack.pop_back();
+            if (!condition)
+                ip = code + instruction->A;
+            DISPATCH();
+        }
+        CASE(ENTER_SCOPE)
+        {
+            m_Visitor.EnterScope(chunk.Scopes[instruction->A]);
+            DISPATCH();
+        }
+        CASE(BUILD_LIST)
+        {
+            Visitor::CheckMemoryLimit(NODE(), ListRecursiveWrapper::BytesFor(instruction->A));
+            {
+                const auto first = stack.end() - instruction->A;
+                auto list = MakeRef<ListRecursiveWrapper>(
+                    std::vector<EvaluatedValue>(std::make_move_iterator(first), std::make_move_iterator(stack.end())));
+                stack.erase(first, stack.end());
+                stack.emplace_back(std::move(list));
+            }
+            DISPATCH();
+        }
+        CASE(BUILD_MAP)
+        {
+            Visitor::CheckMemoryLimit(NODE(), MapRecursiveWrapper::BytesFor(instruction->A));
+            {
+                const auto &mapNode = NODE_AS(MapNode);
+                const auto first = stack.end() - 2 * instruction->A;
+                auto map = MakeRef<MapRecursiveWrapper>();
+                map->elements.reserve(instruction->A);
+
+                for (int i = 0; i < instruction->A; i++)
+                {
+                    auto &key = first[2 * i];
+                    if (!key.IsString())
+                        throw AlengError("Map key must be evaluated to a string.", *mapNode.Elements[i].first);
+                    map->elements[key.AsStringStorage()] = std::move(first[2 * i + 1]);
+                }
+
+                map->UpdateCharge();
+                stack.erase(first, stack.end());
+                stack.emplace_back(std::move(map));
+            }
+            DISPATCH();
+        }
+        CASE(MAKE_FUNCTION)
+        {
+            stack.push_back(m_Visitor.Visit(NODE_AS(FunctionDefinitionNode)));
+            DISPATCH();
+        }
+        CASE(CALL)
+        {
+            const auto &callNode = NODE_AS(FunctionCallNode);
+            const auto argCount = instruction->A;
+            const auto calleeIndex = stack.size() - 1 - argCount;
+
+            if (!stack[calleeIndex].IsFunction())
+            {
+                std::stringstream ss;
+                callNode.CallableExpression->Print(ss);
+                throw AlengError("Expression '" + ss.str() + "' is not callable.", callNode);
+            }
+
+            {
+                // The callee may grow the shared stack, so take everything we need out of it first.
+                const FunctionStorage function(&stack[calleeIndex].AsFunction());
+                std::vector<EvaluatedValue> args(std::make_move_iterator(stack.begin() + static_cast<std::ptrdiff_t>(calleeIndex) + 1),
+                                                 std::make_move_iterator(stack.end()));
+                stack.resize(calleeIndex);
+
+                stack.push_back(m_Visitor.CallFunction(*function, args, callNode));
+            }
+            DISPATCH();
+        }
+        CASE(IMPORT)
+        {
+            stack.push_back(m_Visitor.Visit(NODE_AS(ImportModuleNode)));
+            DISPATCH();
+        }
+        CASE(FOR_RANGE_PREP)
+        {
+            const auto &forNode = NODE();
+            const bool hasStep = instruction->A & FOR_RANGE_HAS_STEP;
+            const auto base = stack.size() - (hasStep ? 3 : 2);
+            int64_t step = 1;
+
+            if (hasStep)
+            {
+                if (stack[base + 2].IsNumber())
+                    step = stack[base + 2].ToInteger();
+                else
+                    throw AlengError("Step value in For loop must be a number.", forNode);
+            }
+
+            if (!stack[base].IsNumber())
+                throw AlengError("Start value in numeric For loop must be a number.", forNode);
+            if (!stack[base + 1].IsNumber())
+                throw AlengError("End value in numeric For loop must be a number.", forNode);
+
+            if (step == 0)
+                throw AlengError("Step value in For loop cannot be zero.", forNode);
+
+            const int64_t current = stack[base].ToInteger();
+            if (!hasStep && current > stack[base + 1].AsNumber())
+                step = -1;
+            const int64_t last = Visitor::LastLoopValue(stack[base + 1], step, instruction->A & FOR_RANGE_UNTIL);
+
+            stack.resize(base);
+            stack.emplace_back(current);
+            stack.emplace_back(last);
+            stack.emplace_back(step);
+            DISPATCH();
+        }
+        CASE(FOR_RANGE_NEXT)
+        {
+            const int64_t current = PEEK(2).AsInteger();
+            const int64_t last = PEEK(1).AsInteger();
+
+            if (PEEK(0).AsInteger() > 0 ? current > last : current < last)
+                ip = code + instruction->A;
+            else
+                m_Visitor.BindingStorage(NODE_AS(ForStatementNode).IteratorBinding) = current;
+            DISPATCH();
+        }
+        CASE(FOR_RANGE_STEP)
+        {
+            const int64_t last = PEEK(1).AsInteger();
+            const int64_t step = PEEK(0).AsInteger();
+            int64_t current;
+
+            if (!AddOverflows(PEEK(2).AsInteger(), step, current) && (step > 0 ? current <= last : current >= last))
+            {
+                m_Visitor.ConsumeStep(NODE());
+                PEEK(2) = current;
+                m_Visitor.BindingStorage(NODE_AS(ForStatementNode).IteratorBinding) = current;
+                ip = code + instruction->A;
+            }
+            DISPATCH();
+        }
+        CASE(FOR_ITER_PREP)
+        {
+            if (TOP().IsMap())
+            {
+                // Iterate over a snapshot of the keys so the body may mutate the map.
+                Visitor::CheckMemoryLimit(NODE(), ListRecursiveWrapper::BytesFor(TOP().AsMap().elements.size()));
+                auto keys = MakeRef<ListRecursiveWrapper>();
+                keys->elements.reserve(TOP().AsMap().elements.size());
+                for (const auto &key : TOP().AsMap().elements | std::views::keys)
+                    keys->elements.emplace_back(key);
+                keys->UpdateCharge();
+                TOP() = std::move(keys);
+            }
+            else if (!TOP().IsList())
+                throw AlengError("For loop collection must be a List (Maps not supported yet).", NODE());
+
+            stack.emplace_back(int64_t{0});
+            DISPATCH();
+        }
+        CASE(FOR_ITER_NEXT)
+        {
+            const auto &elements = PEEK(1).AsList().elements;
+            const int64_t index = PEEK(0).AsInteger();
+
+            if (index >= static_cast<int64_t>(elements.size()))
+                ip = code + instruction->A;
+            else
+            {
+                m_Visitor.BindingStorage(NODE_AS(ForStatementNode).IteratorBinding) = elements[static_cast<size_t>(index)];
+                PEEK(0) = index + 1;
+            }
+            DISPATCH();
+        }
+        CASE(POP_LOOP)
+        {
+            stack.resize(stack.size() - instruction->A);
+            DISPATCH();
+        }
+        CASE(EVALUATE)
+        {
+            stack.push_back(NODE().Accept(m_Visitor));
+            DISPATCH();
+        }
+        CASE(RETURN)
+        {
+            return std::move(TOP());
+        }
+
+        #ifndef ALENG_COMPUTED_GOTO
+                }
+            }
+        #endif
+
+        #undef NODE
+        #undef NODE_AS
+        #undef TOP
+        #undef PEEK
+        #undef BINARY_RESULT
+        #undef BINARY_OP
+        #undef ARITHMETIC_OP
+        #undef LOAD_FROM
+        #undef STORE_TO
+        #undef DISPATCH
+        #undef CASE
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "AST.h"
+#include "Bytecode.h"
+
+namespace Aleng
+{
+    class Visitor;
+
+    // Stack machine that runs compiled chunks. Environments, calls and natives stay owned
+    // by the Visitor so both execution modes share the exact same runtime semantics.
+    class VM
+    {
+    public:
+        explicit VM(Visitor &visitor);
+
+        EvaluatedValue Execute(const ProgramNode &program);
+        // Runs a user function body inside the scope prepared by Visitor::CallFunction.
+        EvaluatedValue Execute(const FunctionObject &function);
+
+    private:
+        EvaluatedValue Run(const Chunk &chunk);
+
+    private:
+        Visitor &m_Visitor;
+        std::vector<EvaluatedValue> m_Stack;
+    };
+}
@@ -0,0 +1,136 @@
+#include "Value.h"
+
+#include <unordered_set>
+
+#include "AST.h"
+
+namespace Aleng
+{
+    void DestroyObject(HeapObject *object)
+    {
+        switch (object->Kind)
+        {
+        case ObjectKind::STRING:
+        {
+            // Ropes nest as deep as the loop that built them, so free them without recursing.
+            std::vector<StringObject *> pending{static_cast<StringObject *>(object)};
+            while (!pending.empty())
+            {
+                auto *string = pending.back();
+                pending.pop_back();
+                for (auto *half : {string->m_Left.release(), string->m_Right.release()})
+                {
+                    if (half && --half->RefCount == 0)
+                        pending.push_back(half);
+                }
+                delete string;
+            }
+            break;
+        }
+        case ObjectKind::LIST:
+            delete static_cast<ListRecursiveWrapper *>(object);
+            break;
+        case ObjectKind::MAP:
+            delete static_cast<MapRecursiveWrapper *>(object);
+            break;
+        case ObjectKind::FUNCTION:
+            delete static_cast<FunctionObject *>(object);
+            break;
+        case ObjectKind::INTEGER:
+            delete static_cast<IntegerObject *>(object);
+            break;
+        }
+    }
+
+    // Below this size copying is cheaper than keeping a rope node around.
+    constexpr size_t MIN_ROPE_LENGTH = 64;
+
+    StringStorage ConcatStrings(StringStorage left, StringStorage right)
+    {
+        if (left->Length() == 0)
+            return right;
+        if (right->Length() == 0)
+            return left;
+        if (left->Length() + right->Length() < MIN_ROPE_LENGTH)
+            return MakeRef<StringObject>(left->Value() + right->Value());
+        return MakeRef<StringObject>(std::move(left), std::move(right));
+    }
+
+    void StringObject::Flatten() const
+    {
+        std::string text;
+        text.reserve(m_Length);
+
+        // Walk the halves left to right with an explicit stack; ropes can be very deep.
+        std::vector<const StringObject *> pending{m_Right.get(), m_Left.get()};
+        while (!pending.empty())
+        {
+            const auto *string = pending.back();
+            pending.pop_back();
+            if (string->m_Left)
+            {
+                pending.push_back(string->m_Right.get());
+                pending.push_back(string->m_Left.get());
+            }
+            else
+                text += string->m_Value;
+        }
+
+        m_Value = std::move(text);
+        m_Left = nullptr;
+        m_Right = nullptr;
+        ChargeBytes(sizeof(StringObject) + m_Length);
+    }
+
+    StringStorage InternString(const std::string_view string)
+    {
+        // One table per thread, like the values it hands out, so interpreters on other threads never touch it.
+        thread_local std::unordered_set<StringStorage, StringKeyHash, StringKeyEqual> table;
+
+        if (const auto it = table.find(string); it != table.end())
+            return *it;
+        // The table is shared by every Visitor on the thread and never shrinks, so no account pays for it.
+        MemoryAccount::Scope unaccounted(nullptr);
+        auto interned = MakeRef<StringObject>(std::string(string));
+        interned->m_Interned = true;
+        return *table.insert(std::move(interned)).first;
+    }
+
+    const Shape *Shape::Empty()
+    {
+        // Each thread grows its own tree, so Transition never needs a lock.
+        thread_local const Shape empty;
+        return &empty;
+    }
+
+    const Shape *Shape::Transition(const StringStorage &key) const
+    {
+        if (!key->IsInterned() || Length >= MAX_LENGTH)
+            return nullptr;
+
+        auto &next = m_Transitions[key.get()];
+        if (!next)
+        {
+            next = std::make_unique<Shape>();
+            next->Length = Length + 1;
+        }
+        return next.get();
+    }
+
+    uint64_t EvaluatedValue::BoxInteger(const int64_t number)
+    {
+        EvaluatedValue boxed(new IntegerObject(number), ObjectKind::INTEGER);
+        return std::exchange(boxed.m_Bits, 0);
+    }
+
+    bool EvaluatedValue::operator==(const EvaluatedValue &other) const
+    {
+        if (IsInteger() && other.IsInteger())
+            return AsInteger() == other.AsInteger();
+        if (IsNumber() || other.IsNumber())
+            return IsNumber() && other.IsNumber() && AsNumber() == other.AsNumber();
+        if (IsString() && other.IsString())
+            return AsObject() == other.AsObject() || AsString() == other.AsString();
+        return m_Bits == other.m_Bits;
+    }
+}
@@ -0,0 +1,684 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MemoryAccount.h"
+
+namespace Aleng
+{
+    enum class ObjectKind : uint8_t
+    {
+        STRING,
+        LIST,
+        MAP,
+        FUNCTION,
+        INTEGER
+    };
+
+    // Common header of every heap value. The count is not atomic: a value belongs to the thread that created it.
+    // A value is charged to the memory account active when it was created, if any.
+    struct HeapObject
+    {
+        uint32_t RefCount = 0;
+        ObjectKind Kind;
+        MemoryAccount *const Account;
+
+        explicit HeapObject(const ObjectKind kind) : Kind(kind), Account(MemoryAccount::Active())
+        {
+            if (Account)
+                Account->Retain();
+        }
+        HeapObject(const HeapObject &other) : HeapObject(other.Kind) {}
+        HeapObject &operator=(const HeapObject &) { return *this; }
+        ~HeapObject()
+        {
+            if (Account)
+            {
+                Account->Credit(m_ChargedBytes);
+                Account->Release();
+            }
+        }
+
+        // Charges the value's current size, in total; called again whenever it grows.
+        void ChargeBytes(const size_t bytes) const
+        {
+            if (Account && bytes != m_ChargedBytes)
+            {
+                Account->Credit(m_ChargedBytes);
+                Account->Charge(bytes);
+            }
+            m_ChargedBytes = bytes;
+        }
+
+    private:
+        mutable size_t m_ChargedBytes = 0;
+    };
+
+    // Heap values that can hold other values and so can form reference cycles: lists, maps and functions.
+    // Every live one is linked into a list that the GarbageCollector walks.
+    struct TrackedObject : HeapObject
+    {
+        explicit TrackedObject(const ObjectKind kind) : HeapObject(kind) { Link(); }
+        TrackedObject(const TrackedObject &other) : HeapObject(other) { Link(); }
+        TrackedObject &operator=(const TrackedObject &) { return *this; }
+        ~TrackedObject() { Unlink(); }
+
+    private:
+        friend class GarbageCollector;
+
+        void Link();
+        void Unlink();
+
+        TrackedObject *m_Previous = nullptr;
+        TrackedObject *m_Next = nullptr;
+    };
+
+    void DestroyObject(HeapObject *object);
+
+    inline void RetainObject(HeapObject *object)
+    {
+        ++object->RefCount;
+    }
+
+    inline void ReleaseObject(HeapObject *object)
+    {
+        if (--object->RefCount == 0)
+            DestroyObject(object);
+    }
+
+    // Owning pointer to a heap value, sharing the count stored in the object itself.
+    template <class T>
+    class Ref
+    {
+    public:
+        Ref() = default;
+        Ref(std::nullptr_t) {}
+        explicit Ref(T *object) : m_Object(object)
+        {
+            if (m_Object)
+                RetainObject(m_Object);
+        }
+        Ref(const Ref &other) : Ref(other.m_Object) {}
+        Ref(Ref &&other) noexcept : m_Object(std::exchange(other.m_Object, nullptr)) {}
+        ~Ref()
+        {
+            if (m_Object)
+                ReleaseObject(m_Object);
+        }
+
+        Ref &operator=(Ref other) noexcept
+        {
+            std::swap(m_Object, other.m_Object);
+            return *this;
+        }
+
+        T *operator->() const { return m_Object; }
+        T &operator*() const { return *m_Object; }
+        [[nodiscard]] T *get() const { return m_Object; }
+        // Gives up ownership without touching the count.
+        [[nodiscard]] T *release() { return std::exchange(m_Object, nullptr); }
+        explicit operator bool() const { return m_Object != nullptr; }
+        bool operator==(const Ref &other) const { return m_Object == other.m_Object; }
+
+    private:
+        T *m_Object = nullptr;
+    };
+
+    template <class T, class... Args>
+    Ref<T> MakeRef(Args &&...args)
+    {
+        return Ref<T>(new T(std::forward<Args>(args)...));
+    }
+
+    struct StringObject;
+    struct IntegerObject;
+    struct ListRecursiveWrapper;
+    struct MapRecursiveWrapper;
+    struct FunctionObject;
+
+    using StringStorage = Ref<StringObject>;
+    using ListStorage = Ref<ListRecursiveWrapper>;
+    using MapStorage = Ref<MapRecursiveWrapper>;
+    using FunctionStorage = Ref<FunctionObject>;
+
+    // A runtime value in 8 bytes (NaN boxing). Doubles are stored as they are; booleans, integers that fit
+    // in 48 bits and heap pointers live in the payload of a quiet NaN, with the object kind in the pointer's
+    // low bits. Larger integers are boxed. Integers and doubles are both numbers to the language.
+    class EvaluatedValue
+    {
+    public:
+        EvaluatedValue() : EvaluatedValue(0.0) {}
+        EvaluatedValue(const double number)
+        {
+            // Every NaN the program produces collapses to one that cannot be mistaken for a tag.
+            m_Bits = number != number ? CANONICAL_NAN : std::bit_cast<uint64_t>(number);
+        }
+        EvaluatedValue(int64_t number);
+        EvaluatedValue(const int number) : EvaluatedValue(static_cast<int64_t>(number)) {}
+        EvaluatedValue(const bool boolean) : m_Bits(boolean ? TRUE_BITS : FALSE_BITS) {}
+        EvaluatedValue(const char *string);
+        EvaluatedValue(std::string string);
+        EvaluatedValue(const StringStorage &string);
+        EvaluatedValue(const ListStorage &list);
+        EvaluatedValue(const MapStorage &map);
+        EvaluatedValue(const FunctionStorage &function);
+
+        EvaluatedValue(const EvaluatedValue &other) : m_Bits(other.m_Bits)
+        {
+            if (IsObject())
+                RetainObject(AsObject());
+        }
+        EvaluatedValue(EvaluatedValue &&other) noexcept : m_Bits(std::exchange(other.m_Bits, 0)) {}
+        ~EvaluatedValue()
+        {
+            if (IsObject())
+                ReleaseObject(AsObject());
+        }
+
+        EvaluatedValue &operator=(const EvaluatedValue &other)
+        {
+            if (other.IsObject())
+                RetainObject(other.AsObject());
+            if (IsObject())
+                ReleaseObject(AsObject());
+            m_Bits = other.m_Bits;
+            return *this;
+        }
+        EvaluatedValue &operator=(EvaluatedValue &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (IsObject())
+                    ReleaseObject(AsObject());
+                m_Bits = std::exchange(other.m_Bits, 0);
+            }
+            return *this;
+        }
+
+        [[nodiscard]] bool IsDouble() const { return (m_Bits & QNAN) != QNAN; }
+        [[nodiscard]] bool IsInteger() const { return IsSmallInteger() || IsObjectOf(ObjectKind::INTEGER); }
+        [[nodiscard]] bool IsNumber() const { return IsDouble() || IsInteger(); }
+        [[nodiscard]] bool IsBool() const { return (m_Bits | 1) == TRUE_BITS; }
+        [[nodiscard]] bool IsObject() const { return (m_Bits & OBJECT_TAG) == OBJECT_TAG; }
+        [[nodiscard]] bool IsString() const { return IsObjectOf(ObjectKind::STRING); }
+        [[nodiscard]] bool IsList() const { return IsObjectOf(ObjectKind::LIST); }
+        [[nodiscard]] bool IsMap() const { return IsObjectOf(ObjectKind::MAP); }
+        [[nodiscard]] bool IsFunction() const { return IsObjectOf(ObjectKind::FUNCTION); }
+
+        [[nodiscard]] double AsDouble() const { return std::bit_cast<double>(m_Bits); }
+        [[nodiscard]] int64_t AsInteger() const;
+        // Either kind of number, as a double.
+        [[nodiscard]] double AsNumber() const { return IsDouble() ? AsDouble() : static_cast<double>(AsInteger()); }
+        // Either kind of number, as an integer; doubles are truncated.
+        [[nodiscard]] int64_t ToInteger() const { return IsDouble() ? static_cast<int64_t>(AsDouble()) : AsInteger(); }
+        [[nodiscard]] bool AsBool() const { return m_Bits == TRUE_BITS; }
+        [[nodiscard]] HeapObject *AsObject() const { return reinterpret_cast<HeapObject *>(m_Bits & POINTER_MASK); }
+        [[nodiscard]] const std::string &AsString() const;
+        [[nodiscard]] StringStorage AsStringStorage() const;
+        [[nodiscard]] ListRecursiveWrapper &AsList() const;
+        [[nodiscard]] MapRecursiveWrapper &AsMap() const;
+        [[nodiscard]] FunctionObject &AsFunction() const;
+
+        // Same type and value; containers and functions compare by identity.
+        bool operator==(const EvaluatedValue &other) const;
+
+    private:
+        EvaluatedValue(HeapObject *object, const ObjectKind kind)
+            : m_Bits(OBJECT_TAG | reinterpret_cast<uintptr_t>(object) | static_cast<uint64_t>(kind))
+        {
+            RetainObject(object);
+        }
+
+        [[nodiscard]] bool IsObjectOf(const ObjectKind kind) const
+        {
+            return (m_Bits & (OBJECT_TAG | KIND_MASK)) == (OBJECT_TAG | static_cast<uint64_t>(kind));
+        }
+
+        [[nodiscard]] bool IsSmallInteger() const { return (m_Bits & (OBJECT_TAG | INTEGER_TAG)) == (QNAN | INTEGER_TAG); }
+        static uint64_t BoxInteger(int64_t number);
+
+        static constexpr uint64_t QNAN = 0x7ffc000000000000;
+        static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+        static constexpr uint64_t OBJECT_TAG = SIGN_BIT | QNAN;
+        static constexpr uint64_t KIND_MASK = 0x7;
+        static constexpr uint64_t POINTER_MASK = 0x0003fffffffffff8;
+        static constexpr uint64_t FALSE_BITS = QNAN | 2;
+        static constexpr uint64_t TRUE_BITS = QNAN | 3;
+        static constexpr uint64_t INTEGER_TAG = 0x0002000000000000;
+        static constexpr uint64_t INTEGER_MASK = 0x0000ffffffffffff;
+        static constexpr int64_t SMALL_INTEGER_MAX = (int64_t{1} << 47) - 1;
+        static constexpr int64_t SMALL_INTEGER_MIN = -(int64_t{1} << 47);
+        static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+        uint64_t m_Bits;
+    };
+
+    static_assert(sizeof(EvaluatedValue) == 8);
+
+    // Immutable string. The hash is computed on first use and then reused by every table lookup.
+    // A concatenation only links its two halves (a rope); the text is built the first time it is read,
+    // so appending in a loop stays linear.
+    // Heap objects must keep the low pointer bits free for the kind tag.
+    struct alignas(8) StringObject : HeapObject
+    {
+        explicit StringObject(std::string value)
+            : HeapObject(ObjectKind::STRING), m_Length(value.size()), m_Value(std::move(value))
+        {
+            ChargeBytes(sizeof(StringObject) + m_Length);
+        }
+
+        // The text is charged when it is built, not here.
+        StringObject(Ref<StringObject> left, Ref<StringObject> right)
+            : HeapObject(ObjectKind::STRING), m_Length(left->m_Length + right->m_Length),
+              m_Left(std::move(left)), m_Right(std::move(right))
+        {
+            ChargeBytes(sizeof(StringObject));
+        }
+
+        [[nodiscard]] const std::string &Value() const
+        {
+            if (m_Left)
+                Flatten();
+            return m_Value;
+        }
+
+        [[nodiscard]] size_t Length() const { return m_Length; }
+        [[nodiscard]] bool IsInterned() const { return m_Interned; }
+
+        [[nodiscard]] size_t Hash() const
+        {
+            if (!m_HasHash)
+            {
+                m_Hash = std::hash<std::string_view>{}(Value());
+                m_HasHash = true;
+            }
+            return m_Hash;
+        }
+
+    private:
+        void Flatten() const;
+        friend void DestroyObject(HeapObject *object);
+        friend StringStorage InternString(std::string_view string);
+
+        size_t m_Length;
+        mutable std::string m_Value;
+        mutable Ref<StringObject> m_Left;
+        mutable Ref<StringObject> m_Right;
+        mutable size_t m_Hash = 0;
+        mutable bool m_HasHash = false;
+        bool m_Interned = false;
+    };
+
+    // Concatenates without copying either operand; see StringObject.
+    StringStorage ConcatStrings(StringStorage left, StringStorage right);
+
+    // Hash and equality for string-keyed tables. Both are transparent, so lookups by
+    // std::string_view do not need to build a StringObject.
+    struct StringKeyHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(const StringStorage &string) const { return string->Hash(); }
+        size_t operator()(const std::string_view string) const { return std::hash<std::string_view>{}(string); }
+    };
+
+    struct StringKeyEqual
+    {
+        using is_transparent = void;
+
+        bool operator()(const StringStorage &left, const StringStorage &right) const
+        {
+            return left == right || left->Value() == right->Value();
+        }
+        bool operator()(const StringStorage &left, const std::string_view right) const { return left->Value() == right; }
+        bool operator()(const std::string_view left, const StringStorage &right) const { return left == right->Value(); }
+    };
+
+    template <class T>
+    using StringMap = std::unordered_map<StringStorage, T, StringKeyHash, StringKeyEqual>;
+
+    // The sequence of keys a map was built with. Maps that received the same keys in the same order share
+    // one Shape, so a key found at some position in one of them is at that position in all of them.
+    // Shapes form a tree of transitions from the empty shape, one tree per thread, and live as long as the
+    // thread. Only interned keys (names and literals) extend it, and only up to MAX_LENGTH keys; any other
+    // map has no shape.
+    struct Shape
+    {
+        static constexpr uint32_t MAX_LENGTH = 32;
+
+        uint32_t Length = 0;
+
+        static const Shape *Empty();
+
+        // The shape after appending the key, or null if maps of that layout are not tracked.
+        [[nodiscard]] const Shape *Transition(const StringStorage &key) const;
+
+    private:
+        mutable std::unordered_map<const StringObject *, std::unique_ptr<Shape>> m_Transitions;
+    };
+
+    // Per-site cache of where a key was found, for the last few shapes seen there. A tree must only ever
+    // run on one thread, so these are always that thread's shapes.
+    struct MemberCache
+    {
+        static constexpr size_t WAYS = 4;
+
+        std::array<const Shape *, WAYS> Shapes{};
+        std::array<uint32_t, WAYS> Positions{};
+        size_t Next = 0;
+    };
+
+    // String-keyed map that keeps insertion order, laid out like CPython's dict: the entries sit densely
+    // in a vector, in order, and an open-addressing table of entry indices finds them by key.
+    // Entries are never removed, so an entry's position stays valid while the map grows.
+    template <class T>
+    class OrderedStringMap
+    {
+    public:
+        using value_type = std::pair<StringStorage, T>;
+        using iterator = typename std::vector<value_type>::iterator;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        [[nodiscard]] size_t size() const { return m_Entries.size(); }
+        [[nodiscard]] bool empty() const { return m_Entries.empty(); }
+
+        iterator begin() { return m_Entries.begin(); }
+        iterator end() { return m_Entries.end(); }
+        const_iterator begin() const { return m_Entries.begin(); }
+        const_iterator end() const { return m_Entries.end(); }
+
+        void reserve(const size_t count)
+        {
+            m_Entries.reserve(count);
+            if (const size_t capacity = IndexCapacityFor(count); capacity > m_Index.size())
+                Rehash(capacity);
+        }
+
+        [[nodiscard]] const Shape *GetShape() const { return m_Shape; }
+
+        // Heap bytes held by the entries and the index.
+        [[nodiscard]] size_t AllocatedBytes() const
+        {
+            return m_Entries.capacity() * sizeof(value_type) + m_Index.capacity() * sizeof(int32_t);
+        }
+        // Heap bytes a map built with count keys holds.
+        [[nodiscard]] static size_t BytesFor(const size_t count)
+        {
+            return count * sizeof(value_type) + IndexCapacityFor(count) * sizeof(int32_t);
+        }
+        // At most the bytes AllocatedBytes grows by when one more key is added.
+        [[nodiscard]] size_t InsertBytes() const
+        {
+            const size_t entries = m_Entries.size() < m_Entries.capacity() ? 0 : std::max<size_t>(m_Entries.capacity(), 1);
+            const size_t needed = IndexCapacityFor(m_Entries.size() + 1);
+            const size_t index = needed > m_Index.size() ? std::max(m_Index.size() * 2, needed) - m_Index.size() : 0;
+            return entries * sizeof(value_type) + index * sizeof(int32_t);
+        }
+
+        // Looks the key up through the site's cache. A hit costs one comparison per cached shape.
+        iterator find(const StringStorage &key, MemberCache &cache)
+        {
+            if (m_Shape)
+            {
+                for (size_t i = 0; i < MemberCache::WAYS; i++)
+                {
+                    if (cache.Shapes[i] == m_Shape)
+                        return begin() + cache.Positions[i];
+                }
+            }
+
+            const auto it = find(key);
+            if (m_Shape && it != end())
+            {
+                cache.Shapes[cache.Next] = m_Shape;
+                cache.Positions[cache.Next] = static_cast<uint32_t>(it - begin());
+                cache.Next = (cache.Next + 1) % MemberCache::WAYS;
+            }
+            return it;
+        }
+
+        iterator find(const StringStorage &key) { return begin() + Find(key->Hash(), key); }
+        iterator find(const std::string_view key) { return begin() + Find(std::hash<std::string_view>{}(key), key); }
+        const_iterator find(const StringStorage &key) const { return begin() + Find(key->Hash(), key); }
+        const_iterator find(const std::string_view key) const { return begin() + Find(std::hash<std::string_view>{}(key), key); }
+
+        T &operator[](StringStorage key)
+        {
+            const size_t hash = key->Hash();
+            if (IndexCapacityFor(m_Entries.size() + 1) > m_Index.size())
+                Rehash(std::max(m_Index.size() * 2, IndexCapacityFor(m_Entries.size() + 1)));
+
+            int32_t &slot = m_Index[FindSlot(hash, key)];
+            if (slot != EMPTY)
+                return m_Entries[slot].second;
+
+            slot = static_cast<int32_t>(m_Entries.size());
+            if (m_Shape)
+                m_Shape = m_Shape->Transition(key);
+            return m_Entries.emplace_back(std::move(key), T{}).second;
+        }
+
+    private:
+        static constexpr int32_t EMPTY = -1;
+
+        // Keeps the table at most two thirds full, as a power of two.
+        static size_t IndexCapacityFor(const size_t count)
+        {
+            return count == 0 ? 0 : std::bit_ceil(count + count / 2 + 1);
+        }
+
+        template <class K>
+        size_t FindSlot(const size_t hash, const K &key) const
+        {
+            const size_t mask = m_Index.size() - 1;
+            for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+            {
+                const int32_t entry = m_Index[slot];
+                if (entry == EMPTY || StringKeyEqual{}(m_Entries[entry].first, key))
+                    return slot;
+            }
+        }
+
+        // Position of the entry, or size() when the key is missing.
+        template <class K>
+        size_t Find(const size_t hash, const K &key) const
+        {
+            if (m_Index.empty())
+                return m_Entries.size();
+            const int32_t entry = m_Index[FindSlot(hash, key)];
+            return entry == EMPTY ? m_Entries.size() : static_cast<size_t>(entry);
+        }
+
+        void Rehash(const size_t capacity)
+        {
+            m_Index.assign(capacity, EMPTY);
+            const size_t mask = capacity - 1;
+            for (size_t i = 0; i < m_Entries.size(); i++)
+            {
+                size_t slot = m_Entries[i].first->Hash() & mask;
+                while (m_Index[slot] != EMPTY)
+                    slot = (slot + 1) & mask;
+                m_Index[slot] = static_cast<int32_t>(i);
+            }
+        }
+
+        std::vector<value_type> m_Entries;
+        std::vector<int32_t> m_Index;
+        const Shape *m_Shape = Shape::Empty();
+    };
+
+    // Returns the one StringObject for this content on the calling thread. Interned strings live as long
+    // as the thread, so use this for names and literals, not for strings built at runtime.
+    StringStorage InternString(std::string_view string);
+
+    // Integers too large to store inline in an EvaluatedValue.
+    struct alignas(8) IntegerObject : HeapObject
+    {
+        const int64_t Value;
+
+        explicit IntegerObject(const int64_t value) : HeapObject(ObjectKind::INTEGER), Value(value)
+        {
+            ChargeBytes(sizeof(IntegerObject));
+        }
+    };
+
+    // Elements are 8-byte EvaluatedValues in one contiguous array: doubles, booleans and integers within
+    // 48 bits sit inline, while strings, containers, functions and larger integers point to heap objects.
+    // Code that adds elements calls UpdateCharge afterwards.
+    struct alignas(8) ListRecursiveWrapper : TrackedObject
+    {
+        std::vector<EvaluatedValue> elements;
+
+        ListRecursiveWrapper() : TrackedObject(ObjectKind::LIST) { UpdateCharge(); }
+
+        explicit ListRecursiveWrapper(std::vector<EvaluatedValue> elems) : TrackedObject(ObjectKind::LIST), elements(std::move(elems))
+        {
+            UpdateCharge();
+        }
+
+        void UpdateCharge() const { ChargeBytes(sizeof(ListRecursiveWrapper) + elements.capacity() * sizeof(EvaluatedValue)); }
+
+        // Bytes a new list of count elements is charged, so the limit can be checked before building it.
+        [[nodiscard]] static size_t BytesFor(const size_t count) { return sizeof(ListRecursiveWrapper) + count * sizeof(EvaluatedValue); }
+
+        // Capacity for count more elements, growing at least twofold like push_back. Reserving it up front
+        // makes GrowthBytes exact.
+        [[nodiscard]] size_t CapacityFor(const size_t count) const
+        {
+            const size_t needed = elements.size() + count;
+            return needed <= elements.capacity() ? elements.capacity() : std::max(needed, elements.capacity() * 2);
+        }
+        [[nodiscard]] size_t GrowthBytes(const size_t count) const { return (CapacityFor(count) - elements.capacity()) * sizeof(EvaluatedValue); }
+    };
+
+    // Code that adds keys calls UpdateCharge afterwards.
+    struct alignas(8) MapRecursiveWrapper : TrackedObject
+    {
+        OrderedStringMap<EvaluatedValue> elements;
+
+        MapRecursiveWrapper() : TrackedObject(ObjectKind::MAP) { UpdateCharge(); }
+
+        explicit MapRecursiveWrapper(OrderedStringMap<EvaluatedValue> elems)
+            : TrackedObject(ObjectKind::MAP), elements(std::move(elems))
+        {
+            UpdateCharge();
+        }
+
+        void UpdateCharge() const { ChargeBytes(sizeof(MapRecursiveWrapper) + elements.AllocatedBytes()); }
+
+        // Bytes a new map of count keys is charged, so the limit can be checked before building it.
+        [[nodiscard]] static size_t BytesFor(const size_t count)
+        {
+            return sizeof(MapRecursiveWrapper) + OrderedStringMap<EvaluatedValue>::BytesFor(count);
+        }
+    };
+
+    inline EvaluatedValue::EvaluatedValue(const int64_t number)
+    {
+        if (number >= SMALL_INTEGER_MIN && number <= SMALL_INTEGER_MAX) [[likely]]
+            m_Bits = QNAN | INTEGER_TAG | (static_cast<uint64_t>(number) & INTEGER_MASK);
+        else
+            m_Bits = BoxInteger(number);
+    }
+
+    inline int64_t EvaluatedValue::AsInteger() const
+    {
+        if (IsSmallInteger()) [[likely]]
+            return static_cast<int64_t>(m_Bits << 16) >> 16; // sign-extends the 48-bit payload
+        return static_cast<const IntegerObject *>(AsObject())->Value;
+    }
+
+    // Integer arithmetic that reports overflow instead of wrapping; callers fall back to doubles.
+    inline bool AddOverflows(const int64_t left, const int64_t right, int64_t &result)
+    {
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_add_overflow(left, right, &result);
+    #else
+        if ((right > 0 && left > INT64_MAX - right) || (right < 0 && left < INT64_MIN - right))
+            return true;
+        result = left + right;
+        return false;
+    #endif
+    }
+
+    inline bool SubtractOverflows(const int64_t left, const int64_t right, int64_t &result)
+    {
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_sub_overflow(left, right, &result);
+    #else
+        if ((right < 0 && left > INT64_MAX + right) || (right > 0 && left < INT64_MIN + right))
+            return true;
+        result = left - right;
+        return false;
+    #endif
+    }
+
+    inline bool MultiplyOverflows(const int64_t left, const int64_t right, int64_t &result)
+    {
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_mul_overflow(left, right, &result);
+    #else
+        if (left > 0 ? (right > 0 ? left > INT64_MAX / right : right < INT64_MIN / left)
+                     : (right > 0 ? left < INT64_MIN / right : left != 0 && right < INT64_MAX / left))
+            return true;
+        result = left * right;
+        return false;
+    #endif
+    }
+
+    inline EvaluatedValue::EvaluatedValue(std::string string)
+        : EvaluatedValue(new StringObject(std::move(string)), ObjectKind::STRING)
+    {
+    }
+
+    inline EvaluatedValue::EvaluatedValue(const StringStorage &string)
+        : EvaluatedValue(string.get(), ObjectKind::STRING)
+    {
+    }
+
+    inline EvaluatedValue::EvaluatedValue(const char *string)
+        : EvaluatedValue(std::string(string))
+    {
+    }
+
+    inline EvaluatedValue::EvaluatedValue(const ListStorage &list)
+        : EvaluatedValue(list.get(), ObjectKind::LIST)
+    {
+    }
+
+    inline EvaluatedValue::EvaluatedValue(const MapStorage &map)
+        : EvaluatedValue(map.get(), ObjectKind::MAP)
+    {
+    }
+
+    inline const std::string &EvaluatedValue::AsString() const
+    {
+        return static_cast<const StringObject *>(AsObject())->Value();
+    }
+
+    inline StringStorage EvaluatedValue::AsStringStorage() const
+    {
+        return StringStorage(static_cast<StringObject *>(AsObject()));
+    }
+
+    inline ListRecursiveWrapper &EvaluatedValue::AsList() const
+    {
+        return *static_cast<ListRecursiveWrapper *>(AsObject());
+    }
+
+    inline MapRecursiveWrapper &EvaluatedValue::AsMap() const
+    {
+        return *static_cast<MapRecursiveWrapper *>(AsObject());
+    }
+
+    void PrintEvaluatedValue(const EvaluatedValue &value, bool raw = false);
+}
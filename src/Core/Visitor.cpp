@@ -6,17 +6,18 @@
 #include <iostream>
 #include <ranges>
 #include <sstream>
+#include <utility>
 
-#include "StdLib.h"
-
-#include "Parser.h"
+#include "AstCache.h"
+#include "GarbageCollector.h"
 
 #include "Error.h"
 
-#include "ControlFlow.h"
-
 #include "ModuleManager.h"
 
+#include "Resolver.h"
+#include "VM.h"
+
 namespace fs = std::filesystem;
 
 namespace Aleng
@@ -44,19 +45,145 @@ namespace Aleng
         }
     }
 
-    struct ScopedEnvironmentSwap {
-        SymbolTableStack& m_TargetStack;
-        SymbolTableStack m_SavedStack;
+    // Opens a fresh flat frame for a call or a program and restores the caller's on exit.
+    class Visitor::CallFrameScope
+    {
+    public:
+        CallFrameScope(Visitor &visitor, std::shared_ptr<const SymbolTableStack> globals, const std::vector<CellPtr> *upvalues, const int localCount, const int cellCount)
+            : m_Visitor(visitor),
+              m_SavedGlobals(std::exchange(visitor.m_SymbolTableStack, std::move(globals))),
+              m_SavedUpvalues(std::exchange(visitor.m_Upvalues, upvalues)),
+              m_SavedLocalBase(std::exchange(visitor.m_LocalBase, visitor.m_Locals.size())),
+              m_SavedCellBase(std::exchange(visitor.m_CellBase, visitor.m_Cells.size())),
+              m_FrameBytes(localCount * sizeof(std::optional<EvaluatedValue>) + cellCount * (sizeof(CellPtr) + sizeof(Cell)))
+        {
+            visitor.m_Locals.resize(visitor.m_LocalBase + localCount);
+            for (int i = 0; i < cellCount; i++)
+                visitor.m_Cells.push_back(std::make_shared<Cell>());
+            visitor.m_Memory->Charge(m_FrameBytes);
+        }
+
+        ~CallFrameScope()
+        {
+            m_Visitor.m_Memory->Credit(m_FrameBytes);
+            m_Visitor.m_Locals.resize(m_Visitor.m_LocalBase);
+            m_Visitor.m_Cells.resize(m_Visitor.m_CellBase);
+            m_Visitor.m_LocalBase = m_SavedLocalBase;
+            m_Visitor.m_CellBase = m_SavedCellBase;
+            m_Visitor.m_Upvalues = m_SavedUpvalues;
+            m_Visitor.m_SymbolTableStack = std::move(m_SavedGlobals);
+        }
+
+    private:
+        Visitor &m_Visitor;
+        std::shared_ptr<const SymbolTableStack> m_SavedGlobals;
+        const std::vector<CellPtr> *m_SavedUpvalues;
+        size_t m_SavedLocalBase;
+        size_t m_SavedCellBase;
+        size_t m_FrameBytes;
+    };
+
+    struct ScopedAstOwner {
+        std::shared_ptr<const void>& m_Target;
+        std::shared_ptr<const void> m_Saved;
+
+        ScopedAstOwner(std::shared_ptr<const void>& target, std::shared_ptr<const void> owner)
+            : m_Target(target), m_Saved(std::exchange(target, std::move(owner)))
+        {
+        }
+
+        ~ScopedAstOwner() {
+            m_Target = std::move(m_Saved);
+        }
+    };
+
+    // Copies a snapshot's scopes for a fork. Every list, map, closure and captured cell reachable from them
+    // is copied once, so values shared or cyclic in the snapshot stay so in the copy, and closures see the
+    // copied scopes. Strings, numbers and builtins cannot change and are shared.
+    class ForkCopier
+    {
+    public:
+        std::shared_ptr<SymbolTableStack> CopyStack(const SymbolTableStack &stack)
+        {
+            if (auto it = m_Stacks.find(&stack); it != m_Stacks.end())
+                return it->second;
+
+            auto copy = std::make_shared<SymbolTableStack>();
+            m_Stacks.emplace(&stack, copy);
+            copy->reserve(stack.size());
+            for (const auto &table : stack)
+                copy->push_back(CopyTable(table));
+            return copy;
+        }
+
+    private:
+        SymbolTablePtr CopyTable(const SymbolTablePtr &table)
+        {
+            if (auto it = m_Tables.find(table.get()); it != m_Tables.end())
+                return it->second;
+
+            auto copy = std::make_shared<SymbolTable>(*table);
+            m_Tables.emplace(table.get(), copy);
+            for (auto &value : *copy | std::views::values)
+                value = Copy(value);
+            return copy;
+        }
 
-        ScopedEnvironmentSwap(SymbolTableStack& visitorStack, SymbolTableStack newEnv)
-            : m_TargetStack(visitorStack), m_SavedStack(std::move(visitorStack))
+        CellPtr CopyCell(const CellPtr &cell)
         {
-            m_TargetStack = std::move(newEnv);
+            if (!cell)
+                return nullptr;
+            if (auto it = m_Cells.find(cell.get()); it != m_Cells.end())
+                return it->second;
+
+            auto copy = std::make_shared<Cell>();
+            m_Cells.emplace(cell.get(), copy);
+            if (cell->Value)
+                copy->Value = Copy(*cell->Value);
+            return copy;
         }
 
-        ~ScopedEnvironmentSwap() {
-            m_TargetStack = std::move(m_SavedStack);
+        EvaluatedValue Copy(const EvaluatedValue &value)
+        {
+            const bool isUserFunction = value.IsFunction() && value.AsFunction().Type == FunctionObject::Type::USER_DEFINED;
+            if (!value.IsList() && !value.IsMap() && !isUserFunction)
+                return value;
+            if (auto it = m_Objects.find(value.AsObject()); it != m_Objects.end())
+                return it->second;
+
+            if (value.IsList())
+            {
+                auto list = MakeRef<ListRecursiveWrapper>(value.AsList().elements);
+                m_Objects.emplace(value.AsObject(), list);
+                for (auto &element : list->elements)
+                    element = Copy(element);
+                return list;
+            }
+
+            if (value.IsMap())
+            {
+                auto map = MakeRef<MapRecursiveWrapper>(value.AsMap().elements);
+                m_Objects.emplace(value.AsObject(), map);
+                for (auto &element : map->elements | std::views::values)
+                    element = Copy(element);
+                return map;
+            }
+
+            const auto &function = value.AsFunction();
+            auto copy = MakeRef<FunctionObject>(function.Name, function.UserFuncNodeAst, nullptr,
+                                                std::vector<CellPtr>(function.Upvalues.size()));
+            m_Objects.emplace(value.AsObject(), copy);
+            if (function.Globals)
+                copy->Globals = CopyStack(*function.Globals);
+            for (size_t i = 0; i < function.Upvalues.size(); i++)
+                copy->Upvalues[i] = CopyCell(function.Upvalues[i]);
+            return copy;
         }
+
+        std::unordered_map<const SymbolTableStack *, std::shared_ptr<SymbolTableStack>> m_Stacks;
+        std::unordered_map<const SymbolTable *, SymbolTablePtr> m_Tables;
+        std::unordered_map<const Cell *, CellPtr> m_Cells;
+        std::unordered_map<const HeapObject *, EvaluatedValue> m_Objects;
     };
 }
 
@@ -64,25 +191,28 @@ namespace Aleng
 {
     AlengType Visitor::GetAlengType(const EvaluatedValue &val)
     {
-        if (std::holds_alternative<double>(val))
+        if (val.IsNumber())
             return AlengType::NUMBER;
-        if (std::holds_alternative<std::string>(val))
+        if (val.IsString())
             return AlengType::STRING;
-        if (std::holds_alternative<bool>(val))
+        if (val.IsBool())
             return AlengType::BOOLEAN;
-        if (std::holds_alternative<ListStorage>(val))
+        if (val.IsList())
             return AlengType::LIST;
-        if (std::holds_alternative<MapStorage>(val))
+        if (val.IsMap())
             return AlengType::MAP;
-        if (std::holds_alternative<FunctionStorage>(val))
+        if (val.IsFunction())
             return AlengType::FUNCTION;
         throw std::runtime_error("Unsupported EvaluatedValue type encountered in GetAlengType.");
     }
 
-    Visitor::Visitor(ModuleManager& moduleManager)
-        : m_ModuleManager(moduleManager)
+    Visitor::Visitor(ModuleManager& moduleManager, const ExecutionMode mode)
+        : m_ModuleManager(moduleManager), m_Memory(new MemoryAccount()), m_ExecutionMode(mode), m_VM(std::make_unique<VM>(*this))
     {
-        PushScope();
+        {
+            MemoryAccount::Scope memoryScope(m_Memory);
+            PushScope();
+        }
 
         RegisterBuiltinCallback("Print", [&](Visitor &visitor, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
                                               {
@@ -101,36 +231,64 @@ namespace Aleng
             if (args.size() != 1)
                 throw AlengError("ToNumber expects exacts 1 argument", ctx);
             auto& arg = args[0];
-            const bool isNumber = std::holds_alternative<double>(arg);
-            return isNumber ? arg : std::stod(std::get<std::string>(arg)); });
+            return arg.IsNumber() ? arg : std::stod(arg.AsString()); });
 
         RegisterBuiltinCallback("Append", [&](Visitor &, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
                                                {
                 if (args.size() < 2)
                     throw AlengError("Append expects (List, ...).", ctx);
-                auto objectVal = args[0];
+                const auto &objectVal = args[0];
 
-                if (auto pListWrapper = std::get_if<ListStorage>(&objectVal))
+                if (objectVal.IsList())
                 {
+                    auto &list = objectVal.AsList();
+                    CheckMemoryLimit(ctx, list.GrowthBytes(args.size() - 1));
+                    list.elements.reserve(list.CapacityFor(args.size() - 1));
                     for(size_t i = 1; i < args.size(); i++)
-                        (*pListWrapper)->elements.push_back(args[i]);
-                    return *pListWrapper;
+                        list.elements.push_back(args[i]);
+                    list.UpdateCharge();
+                    return objectVal;
                 }
 
                 throw AlengError(
                     "Object of type '" + AlengTypeToString(GetAlengType(objectVal)) + "' not supported for Append function.", ctx); });
+        RegisterBuiltinCallback("Join", [&](Visitor &, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
+                                             {
+                if (args.empty() || args.size() > 2 || !args[0].IsList() || (args.size() == 2 && !args[1].IsString()))
+                    throw AlengError("Join expects (List, [Separator]).", ctx);
+
+                const auto &elements = args[0].AsList().elements;
+                const std::string separator = args.size() == 2 ? args[1].AsString() : "";
+                size_t length = elements.empty() ? 0 : separator.size() * (elements.size() - 1);
+                for (const auto &element : elements)
+                {
+                    if (!element.IsString())
+                        throw AlengError("Join expects a list of strings, found '" + AlengTypeToString(GetAlengType(element)) + "'.", ctx);
+                    length += element.AsStringStorage()->Length();
+                }
+
+                CheckMemoryLimit(ctx, length);
+                std::string result;
+                result.reserve(length);
+                for (size_t i = 0; i < elements.size(); i++)
+                {
+                    if (i > 0)
+                        result += separator;
+                    result += elements[i].AsString();
+                }
+                return result; });
         RegisterBuiltinCallback("Pop", [&](Visitor &, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
                                             {
                 if (args.size() != 1)
                     throw AlengError("Len expects exacts one list as argument.", ctx);
                 auto objectVal = args[0];
 
-                if (const auto pListWrapper = std::get_if<ListStorage>(&objectVal))
+                if (objectVal.IsList())
                 {
-                    if(const auto& elements = (*pListWrapper)->elements; !elements.empty())
+                    if(auto& elements = objectVal.AsList().elements; !elements.empty())
                     {
                         auto element = elements[elements.size()-1];
-                        (*pListWrapper)->elements.pop_back();
+                        elements.pop_back();
                         return element;
                     }
                     else
@@ -139,249 +297,100 @@ namespace Aleng
 
                 throw AlengError(
                     "Object of type '" + AlengTypeToString(GetAlengType(objectVal)) + "' not supported for Pop function.", ctx); });
+    }
 
+    Visitor::Visitor(const Visitor &snapshot, ModuleManager &moduleManager)
+        : m_NativeCallbacks(snapshot.m_NativeCallbacks), m_ModuleManager(moduleManager), m_Memory(new MemoryAccount()),
+          m_ExecutionMode(snapshot.m_ExecutionMode), m_VM(std::make_unique<VM>(*this))
+    {
+        m_Memory->SetLimit(snapshot.m_Memory->GetUsage().Limit);
+        MemoryAccount::Scope memoryScope(m_Memory);
+        m_SymbolTableStack = ForkCopier().CopyStack(*snapshot.m_SymbolTableStack);
+    }
 
-        for (auto stdLibs = StdLib::GetLibraries(); const auto& [name, source] : stdLibs)
-        {
-            try
-            {
-                Parser parser(source, name);
-
-                const auto ast = parser.ParseProgram();
-
-                if (parser.HasErrors())
-                {
-                    for (const auto& err : parser.GetErrors())
-                    {
-                        PrintFormattedError(err, "");
-                    }
-                    continue;
-                }
-
-                PushScope();
-                ast->Accept(*this);
-
-                auto exportsMap = std::make_shared<MapRecursiveWrapper>();
-                if (!m_SymbolTableStack.empty())
-                {
-                    for (const auto& [varName, value] : *m_SymbolTableStack.back())
-                    {
-                        exportsMap->elements[varName] = value;
-                    }
-                }
-                PopScope();
+    Visitor::~Visitor()
+    {
+        m_Memory->Release();
+    }
 
-                m_ModuleManager.RegisterModule(name, exportsMap);
-            }
-            catch (const AlengError& _)
-            {
-                throw;
-            }
-            catch (const std::exception& e)
-            {
-                throw std::runtime_error(
-                    "Fatal Error: Could not initialize standard library '" + name + "': " + e.what());
-            }
-        }
+    std::unique_ptr<Visitor> Visitor::Fork(ModuleManager &moduleManager) const
+    {
+        return std::unique_ptr<Visitor>(new Visitor(*this, moduleManager));
     }
 
     void Visitor::PushScope()
     {
-        m_SymbolTableStack.push_back(std::make_shared<SymbolTable>());
+        auto scopes = m_SymbolTableStack ? std::make_shared<SymbolTableStack>(*m_SymbolTableStack) : std::make_shared<SymbolTableStack>();
+        scopes->push_back(std::make_shared<SymbolTable>());
+        m_SymbolTableStack = std::move(scopes);
     }
 
     void Visitor::PopScope()
     {
-        if (!m_SymbolTableStack.empty())
+        auto scopes = std::make_shared<SymbolTableStack>(*m_SymbolTableStack);
+        if (!scopes->empty())
         {
-            m_SymbolTableStack.pop_back();
+            scopes->pop_back();
         }
 
-        if (m_SymbolTableStack.empty())
+        if (scopes->empty())
             throw std::runtime_error("Symbol table stack was empty, no global scope.");
+        m_SymbolTableStack = std::move(scopes);
+    }
+
+    void Visitor::EnterScope(const ScopeRange &range)
+    {
+        for (int i = range.LocalStart; i < range.LocalEnd; i++)
+            m_Locals[m_LocalBase + i].reset();
+
+        // A cell still held by a closure from an earlier entry must not see this entry's writes.
+        for (int i = range.CellStart; i < range.CellEnd; i++)
+        {
+            auto &cell = m_Cells[m_CellBase + i];
+            if (cell.use_count() > 1)
+                cell = std::make_shared<Cell>();
+            else
+                cell->Value.reset();
+        }
     }
 
     void Visitor::DefineVariable(const std::string &name, const EvaluatedValue &value, bool allowRedefinitionCurrentScope)
     {
-        if (m_SymbolTableStack.empty())
+        if (!m_SymbolTableStack || m_SymbolTableStack->empty())
             PushScope();
 
         if (!allowRedefinitionCurrentScope && IsVariableDefinedInCurrentScope(name))
             throw std::runtime_error("Variable '" + name + "' already defined in the current scope.");
 
-        (*m_SymbolTableStack.back())[name] = value;
+        (*m_SymbolTableStack->back())[InternString(name)] = value;
     }
 
-    void Visitor::AssignVariable(const std::string &name, const EvaluatedValue &value) const
+    void Visitor::AssignVariable(const std::string &name, const EvaluatedValue &value, const ASTNode &node) const
     {
-        for (int i = static_cast<int>(m_SymbolTableStack.size()) - 1; i >= 0; --i)
-        {
-            auto& scope_ptr = m_SymbolTableStack[i];
-            if (scope_ptr->contains(name))
-            {
-                (*scope_ptr)[name] = value;
-                return;
-            }
-        }
+        if (TryAssignGlobal(name, value))
+            return;
 
-        (*m_SymbolTableStack.back())[name] = value;
+        auto &scope = *m_SymbolTableStack->back();
+        CheckMemoryLimit(node, SymbolTableInsertBytes(scope));
+        scope[InternString(name)] = value;
     }
 
     EvaluatedValue Visitor::LookupVariable(const std::string &name)
     {
-        for (const auto & scope_ptr : std::ranges::reverse_view(m_SymbolTableStack))
-            if (scope_ptr->contains(name))
-                return scope_ptr->at(name);
+        for (const auto & scope_ptr : std::ranges::reverse_view(*m_SymbolTableStack))
+            if (const auto it = scope_ptr->find(name); it != scope_ptr->end())
+                return it->second;
 
         throw std::runtime_error("Identifier \"" + name + "\" not defined.");
     }
 
     bool Visitor::IsVariableDefinedInCurrentScope(const std::string &name) const
     {
-        if (m_SymbolTableStack.empty())
+        if (m_SymbolTableStack->empty())
             return false;
-        return m_SymbolTableStack.back()->contains(name);
+        return m_SymbolTableStack->back()->contains(name);
     }
 
-    /*void Visitor::RegisterBuiltinFunctions()
-    {
-
-
-
-
-
-        m_Functions.emplace("Len", Callable([&](Visitor &, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                            {
-                if (args.size() != 1)
-                    throw AlengError("Len expects exacts one argument.", ctx);
-                auto objectVal = args[0];
-
-                if (const auto pString = std::get_if<std::string>(&objectVal))
-                    return static_cast<double>(pString->length());
-                else if (const auto pListWrapper = std::get_if<ListStorage>(&objectVal))
-                    return static_cast<double>((*pListWrapper)->elements.size());
-
-                throw AlengError(
-                    "Object of type '" + AlengTypeToString(GetAlengType(objectVal)) + "' not supported for Len function.", ctx); }));
-
-        m_Functions.emplace("Append", Callable([&](Visitor &, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                               {
-                if (args.size() < 2)
-                    throw AlengError("Append expects (List, ...).", ctx);
-                auto objectVal = args[0];
-
-                if (auto pListWrapper = std::get_if<ListStorage>(&objectVal))
-                {
-                    for(size_t i = 1; i < args.size(); i++)
-                        (*pListWrapper)->elements.push_back(args[i]);
-                    return *pListWrapper;
-                }
-
-                throw AlengError(
-                    "Object of type '" + AlengTypeToString(GetAlengType(objectVal)) + "' not supported for Append function.", ctx); }));
-        m_Functions.emplace("Pop", Callable([&](Visitor &, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                            {
-                if (args.size() != 1)
-                    throw AlengError("Len expects exacts one list as argument.", ctx);
-                auto objectVal = args[0];
-
-                if (const auto pListWrapper = std::get_if<ListStorage>(&objectVal))
-                {
-                    if(const auto& elements = (*pListWrapper)->elements; !elements.empty())
-                    {
-                        auto element = elements[elements.size()-1];
-                        (*pListWrapper)->elements.pop_back();
-                        return element;
-                    }
-                    else
-                        return false;
-                }
-
-                throw AlengError(
-                    "Object of type '" + AlengTypeToString(GetAlengType(objectVal)) + "' not supported for Pop function.", ctx); }));
-
-        m_Functions.emplace("Assert", Callable([&](Visitor &visitor, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                               {
-                        if (args.size() != 2)
-                            throw AlengError("Assert syntax incorrect. Expected: Assert(condition : Boolean, errorMessage : String)", ctx);
-
-                        auto conditionVal = args[0];
-                        auto messageVal = args[1];
-
-                        if (auto pCondition = std::get_if<bool>(&conditionVal))
-                        {
-                            if(auto pMessageStr = std::get_if<std::string>(&messageVal))
-                            {
-                                if(!(*pCondition))
-                                    throw AlengError(*pMessageStr, ctx);
-                                return true;
-                            }
-                            else throw AlengError("Message must be an String.", ctx);
-                        }
-                        else
-                            throw AlengError("Condition must be an Boolean.", ctx); }));
-
-        m_Functions.emplace("Error", Callable([&](Visitor &visitor, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                              {
-            if (args.size() != 1)
-                throw AlengError("Error syntax incorrect. Expected: Error(errorMessage : String) -> Void", ctx);
-
-            auto messageVal = args[0];
-
-            if (auto pMessageStr = std::get_if<std::string>(&messageVal))
-                throw AlengError(*pMessageStr, ctx);
-            else
-                throw AlengError("Message must be an String.", ctx); }));
-
-        m_Functions.emplace("ReadFile", Callable([&](Visitor &visitor, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                                 {
-            if (args.size() != 1)
-                throw AlengError("ReadFile syntax incorrect. Expected ReadFile(path : String) -> String", ctx);
-
-            auto filePathVal = args[0];
-
-            if (auto pFilepath = std::get_if<std::string>(&filePathVal))
-            {
-                auto filepath = fs::absolute(fs::path(*pFilepath));
-
-                if (!fs::exists(filepath))
-                    throw AlengError("Path '" + filepath.string() + "' not exists.", ctx);
-
-                if (fs::is_directory(filepath))
-                    throw AlengError("Path '" + filepath.string() + "' is a directory, not an file.", ctx);
-
-                std::ifstream file(filepath);
-
-                if (!file.is_open())
-                    throw AlengError("Path '" + filepath.string() + "' could not be opened.", ctx);
-
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                file.close();
-
-                return buffer.str();
-            }
-            else
-                throw AlengError("'path' must be an String.", ctx); }));
-
-        m_Functions.emplace("Exit", Callable([&](Visitor &visitor, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx) -> EvaluatedValue
-                                             {
-            if(args.size() > 1)
-                throw AlengError("Exit syntax error. Expected: Error(code : Number?)", ctx);
-
-            EvaluatedValue code = 0.0;
-
-            if(!args.empty())
-                code = args[0];
-
-            if(const auto pCodeDouble = std::get_if<double>(&code))
-            {
-                const auto status = static_cast<int>(*pCodeDouble);
-                exit(status);
-            } else throw AlengError("'code' must be a number.", ctx); }));
-
-    }*/
-
     EvaluatedValue Visitor::ExecuteAlengFile(const std::string &filepath, Visitor &visitor)
     {
         std::ifstream file(filepath);
@@ -396,32 +405,60 @@ namespace Aleng
         file.close();
 
         std::string sourceCode = buffer.str();
-        auto parser = Parser(sourceCode, filepath);
+        std::vector<AlengError> errors;
 
-        auto programAst = parser.ParseProgram();
-        if (parser.HasErrors()) {
-            for (const auto& err : parser.GetErrors()) {
-                PrintFormattedError(err, filepath);
+        auto programAst = AstCache::Load(sourceCode, filepath, errors);
+        if (!errors.empty()) {
+            for (const auto& err : errors) {
+                PrintFormattedError(err);
             }
             return 1.0;
         }
 
-        return programAst->Accept(visitor);
+        return visitor.Execute(std::move(programAst));
+    }
+
+    EvaluatedValue Visitor::Execute(std::shared_ptr<ProgramNode> program)
+    {
+        // Does nothing when this run is nested in another, such as an import.
+        GarbageCollector::CollectIfNeeded();
+        GarbageCollector::RunScope run;
+
+        Resolver::Resolve(*program);
+        MemoryAccount::Scope memoryScope(m_Memory);
+        ScopedAstOwner ownerGuard(m_AstOwner, program);
+        CallFrameScope frame(*this, m_SymbolTableStack, nullptr, program->LocalCount, program->CellCount);
+
+        if (m_ExecutionMode == ExecutionMode::BYTECODE)
+            return m_VM->Execute(*program);
+        return program->Accept(*this);
     }
 
     void Visitor::RegisterBuiltinCallback(const std::string &name, Aleng::BuiltinFunctionCallback callback)
     {
-        m_NativeCallbacks[name] = std::move(callback);
+        m_NativeCallbacks[name] = {std::move(callback), MakeRef<FunctionObject>(name)};
     }
 
     EvaluatedValue Visitor::Visit(const ProgramNode &node)
     {
+        m_Completion = CompletionType::NORMAL;
+
         EvaluatedValue latestResult;
         for (auto &nodePtr : node.Statements)
         {
             latestResult = nodePtr->Accept(*this);
+
+            if (m_Completion == CompletionType::RETURN)
+                break;
+            if (m_Completion != CompletionType::NORMAL)
+            {
+                const bool isBreak = m_Completion == CompletionType::BREAK;
+                m_Completion = CompletionType::NORMAL;
+                throw AlengError(isBreak ? "'Break' used outside of a loop." : "'Continue' used outside of a loop.", *nodePtr);
+            }
         }
 
+        m_Completion = CompletionType::NORMAL;
         return latestResult;
     }
 
@@ -431,15 +468,35 @@ namespace Aleng
         for (auto &nodePtr : node.Statements)
         {
             latestResult = nodePtr->Accept(*this);
+            if (m_Completion != CompletionType::NORMAL)
+                break;
         }
 
         return latestResult;
     }
 
+    bool Visitor::ShouldExitLoop()
+    {
+        switch (m_Completion)
+        {
+        case CompletionType::NORMAL:
+            return false;
+        case CompletionType::CONTINUE:
+            m_Completion = CompletionType::NORMAL;
+            return false;
+        case CompletionType::BREAK:
+            m_Completion = CompletionType::NORMAL;
+            return true;
+        case CompletionType::RETURN:
+            return true;
+        }
+        return true;
+    }
+
     EvaluatedValue Visitor::Visit(const ForStatementNode &node)
     {
         EvaluatedValue lastResult = 0.0;
-        PushScope();
+        EnterScope(node.Scope);
 
         if (node.Type == ForStatementNode::LoopType::NUMERIC && node.NumericLoopInfo)
         {
@@ -447,75 +504,55 @@ namespace Aleng
             auto startVal = info.StartExpression->Accept(*this);
             auto endVal = info.EndExpression->Accept(*this);
             EvaluatedValue stepValRaw;
-            int step = 1;
+            int64_t step = 1;
 
             if (info.StepExpression)
             {
                 stepValRaw = info.StepExpression->Accept(*this);
-                if (auto pStep = std::get_if<double>(&stepValRaw))
-                    step = static_cast<int>(*pStep);
+                if (stepValRaw.IsNumber())
+                    step = stepValRaw.ToInteger();
                 else
                 {
-                    PopScope();
                     throw AlengError("Step value in For loop must be a number.", node);
                 }
             }
 
-            if (auto pStart = std::get_if<double>(&startVal))
+            if (startVal.IsNumber())
             {
-                if (auto pEnd = std::get_if<double>(&endVal))
+                if (endVal.IsNumber())
                 {
-                    int current = static_cast<int>(*pStart);
-                    double limit = *pEnd;
+                    int64_t current = startVal.ToInteger();
 
                     if (step == 0)
                     {
-                        PopScope();
                         throw AlengError("Step value in For loop cannot be zero.", node);
                     }
 
-                    if (!info.StepExpression && current > limit)
+                    if (!info.StepExpression && current > endVal.AsNumber())
                     {
-                        step = -1.0;
+                        step = -1;
                     }
 
-                    auto loopCondition = [&](double curr)
-                    {
-                        if (step > 0)
-                        {
-                            return info.IsUntil ? (curr < limit) : (curr <= limit);
-                        }
-                        else
-                        {
-                            return info.IsUntil ? (curr > limit) : (curr >= limit);
-                        }
-                    };
-
-                    for (; loopCondition(current); current += step)
+                    const int64_t last = LastLoopValue(endVal, step, info.IsUntil);
+
+                    while (step > 0 ? current <= last : current >= last)
                     {
-                        DefineVariable(info.IteratorVariableName, static_cast<double>(current));
-                        try
-                        {
-                            lastResult = node.Body->Accept(*this);
-                        }
-                        catch (const ContinueSignal &_)
-                        {
-                        }
-                        catch (const BreakSignal &_)
-                        {
+                        BindingStorage(node.IteratorBinding) = current;
+                        lastResult = node.Body->Accept(*this);
+                        if (ShouldExitLoop() || AddOverflows(current, step, current))
                             break;
-                        }
+                        // Like FOR_RANGE_STEP, only a step back into the body is counted.
+                        if (step > 0 ? current <= last : current >= last)
+                            ConsumeStep(node);
                     }
                 }
                 else
                 {
-                    PopScope();
                     throw AlengError("End value in numeric For loop must be a number.", node);
                 }
             }
             else
             {
-                PopScope();
                 throw AlengError("Start value in numeric For loop must be a number.", node);
             }
         }
@@ -524,52 +561,50 @@ namespace Aleng
             const auto &info = *node.CollectionLoopInfo;
 
             EvaluatedValue collection = info.CollectionExpression->Accept(*this);
-            if (auto pList = std::get_if<ListStorage>(&collection))
+            if (collection.IsList())
             {
-                for (const auto &item : (*pList)->elements)
+                // By index, like the bytecode engine, so the body may append to the list.
+                const auto &elements = collection.AsList().elements;
+                for (size_t i = 0; i < elements.size(); i++)
                 {
-                    DefineVariable(info.IteratorVariableName, item);
+                    BindingStorage(node.IteratorBinding) = elements[i];
                     lastResult = node.Body->Accept(*this);
+                    if (ShouldExitLoop())
+                        break;
+                    ConsumeStep(node);
                 }
             }
-            else if (auto pMap = std::get_if<MapStorage>(&collection))
+            else if (collection.IsMap())
             {
-                for (const auto &key: (*pMap)->elements | std::views::keys)
+                // Entries keep their position, so walking by index stays valid while the body adds keys.
+                // Keys added by the body are not visited.
+                const auto &elements = collection.AsMap().elements;
+                for (size_t i = 0, count = elements.size(); i < count; i++)
                 {
-                    DefineVariable(info.IteratorVariableName, key);
-                    try
-                    {
-                        lastResult = node.Body->Accept(*this);
-                    }
-                    catch (const ContinueSignal &_)
-                    {
-                    }
-                    catch (const BreakSignal &_)
-                    {
+                    BindingStorage(node.IteratorBinding) = elements.begin()[i].first;
+                    lastResult = node.Body->Accept(*this);
+                    if (ShouldExitLoop())
                         break;
-                    }
+                    ConsumeStep(node);
                 }
             }
             else
             {
-                PopScope();
                 throw AlengError("For loop collection must be a List (Maps not supported yet).", node);
             }
         }
         else
         {
-            PopScope();
             throw AlengError("Invalid ForStatementNode encountered during visitation.", node);
         }
 
-        PopScope();
         return lastResult;
     }
 
     EvaluatedValue Visitor::Visit(const WhileStatementNode &node)
     {
         EvaluatedValue lastResult = 0.0;
-        PushScope();
+        EnterScope(node.Scope);
 
         while (true)
         {
@@ -579,31 +614,13 @@ namespace Aleng
                 break;
             }
 
-            try
-            {
-                lastResult = node.Body->Accept(*this);
-            }
-            catch (const ContinueSignal &_)
-            {
-                continue;
-            }
-            catch (const BreakSignal &_)
-            {
+            lastResult = node.Body->Accept(*this);
+
+            if (ShouldExitLoop())
                 break;
-            }
-            catch (const ReturnSignal &signal)
-            {
-                PopScope();
-                return signal.Value;
-            }
-            catch (const AlengError &_)
-            {
-                PopScope();
-                throw;
-            }
+            ConsumeStep(node);
         }
 
-        PopScope();
         return lastResult;
     }
 
@@ -623,7 +640,11 @@ namespace Aleng
 
     EvaluatedValue Visitor::Visit(const ListNode &node)
     {
-        auto listWrapper = std::make_shared<ListRecursiveWrapper>();
+        // Charged before the elements are evaluated, so their own checks count it.
+        CheckMemoryLimit(node, ListRecursiveWrapper::BytesFor(node.Elements.size()));
+        auto listWrapper = MakeRef<ListRecursiveWrapper>();
+        listWrapper->elements.reserve(node.Elements.size());
+        listWrapper->UpdateCharge();
         for (const auto &elemNode : node.Elements)
         {
             listWrapper->elements.push_back(elemNode->Accept(*this));
@@ -633,16 +654,19 @@ namespace Aleng
 
     EvaluatedValue Visitor::Visit(const MapNode &node)
     {
-        auto mapWrapper = std::make_shared<MapRecursiveWrapper>();
+        CheckMemoryLimit(node, MapRecursiveWrapper::BytesFor(node.Elements.size()));
+        auto mapWrapper = MakeRef<MapRecursiveWrapper>();
+        mapWrapper->elements.reserve(node.Elements.size());
+        mapWrapper->UpdateCharge();
 
         for (const auto &pair : node.Elements)
         {
             EvaluatedValue keyVal = pair.first->Accept(*this);
 
-            if (auto pKeyStr = std::get_if<std::string>(&keyVal))
+            if (keyVal.IsString())
             {
                 EvaluatedValue valueVal = pair.second->Accept(*this);
-                mapWrapper->elements[*pKeyStr] = valueVal;
+                mapWrapper->elements[keyVal.AsStringStorage()] = valueVal;
             }
             else
                 throw AlengError("Map key must be evaluated to a string.", *pair.first);
@@ -653,42 +677,54 @@ namespace Aleng
 
     EvaluatedValue Visitor::ExecuteAndStoreModule(const std::string &sourceCode, const ImportModuleNode& node, const std::string& modulePath)
     {
-        Parser parser(sourceCode, modulePath);
-        const auto ast = parser.ParseProgram();
+        std::vector<AlengError> errors;
+        auto ast = AstCache::Load(sourceCode, modulePath, errors);
 
-        if (parser.HasErrors())
+        if (!errors.empty())
         {
-            for (const auto& err : parser.GetErrors())
+            for (const auto& err : errors)
             {
-                PrintFormattedError(err, modulePath);
+                PrintFormattedError(err);
             }
             return false;
         }
 
+        return ExecuteAndStoreModule(std::move(ast), node);
+    }
+
+    EvaluatedValue Visitor::ExecuteAndStoreModule(std::shared_ptr<ProgramNode> ast, const ImportModuleNode& node)
+    {
         PushScope();
         try
         {
-            ast->Accept(*this);
+            Execute(std::move(ast));
         } catch (const AlengError &_)
         {
             PopScope();
             throw;
         }
+        catch (const ExecutionInterrupted &)
+        {
+            PopScope();
+            throw;
+        }
         catch (const std::exception& e)
         {
             PopScope();
             throw AlengError("Internal error: " + std::string(e.what()), node);
         }
 
-        auto exportsMap = std::make_shared<MapRecursiveWrapper>();
-        if (!m_SymbolTableStack.empty())
+        const auto moduleScope = m_SymbolTableStack->back();
+        PopScope();
+
+        CheckMemoryLimit(node, MapRecursiveWrapper::BytesFor(moduleScope->size()));
+        auto exportsMap = MakeRef<MapRecursiveWrapper>();
+        exportsMap->elements.reserve(moduleScope->size());
+        for (const auto& [Name, Value] : *moduleScope)
         {
-            for (const auto& [Name, Value] : (*m_SymbolTableStack.back()))
-            {
-                exportsMap->elements[Name] = Value;
-            }
+            exportsMap->elements[Name] = Value;
         }
-        PopScope();
+        exportsMap->UpdateCharge();
 
         const EvaluatedValue moduleExports = exportsMap;
         m_ModuleManager.RegisterModule(node.ModuleName, exportsMap);
@@ -701,7 +737,7 @@ namespace Aleng
     }
     EvaluatedValue Visitor::Visit(const IntegerNode &node)
     {
-        return { static_cast<double>(node.Value) };
+        return node.Value;
     }
     EvaluatedValue Visitor::Visit(const FloatNode &node)
     {
@@ -709,20 +745,29 @@ namespace Aleng
     }
     EvaluatedValue Visitor::Visit(const StringNode &node)
     {
-        return node.Value;
+        return node.Interned();
+    }
+    EvaluatedValue Visitor::Visit(const IdentifierNode &node)
+    {
+        return LookupIdentifier(node);
     }
-    EvaluatedValue Visitor::Visit(const IdentifierNode &node) const
+    EvaluatedValue Visitor::LookupIdentifier(const IdentifierNode &node)
     {
-        for (int i = static_cast<int>(m_SymbolTableStack.size()) - 1; i >= 0; i--)
+        if (!node.Binding.IsGlobal())
         {
-            auto& scope_ptr = m_SymbolTableStack[i];
-            if (scope_ptr->contains(node.Value))
-                return scope_ptr->at(node.Value);
+            if (const auto &value = BindingStorage(node.Binding))
+                return *value;
         }
 
-        if (m_NativeCallbacks.contains(node.Value))
+        for (const auto &scope_ptr : std::ranges::reverse_view(*m_SymbolTableStack))
         {
-            return std::make_shared<FunctionObject>(node.Value);
+            if (const auto it = scope_ptr->find(node.Interned()); it != scope_ptr->end())
+                return it->second;
+        }
+
+        if (const auto it = m_NativeCallbacks.find(node.Value); it != m_NativeCallbacks.end())
+        {
+            return it->second.Object;
         }
 
         throw AlengError("Identifier \"" + node.Value + "\" not defined as variable or function.", node);
@@ -732,14 +777,46 @@ namespace Aleng
         auto listObjectVal = node.Object->Accept(*this);
         auto indexVal = node.Index->Accept(*this);
 
-        if (auto listWrapperPtr = std::get_if<ListStorage>(&listObjectVal))
+        return GetIndex(listObjectVal, indexVal, node);
+    }
+    int64_t Visitor::LastLoopValue(const EvaluatedValue &limit, const int64_t step, const bool isUntil)
+    {
+        if (limit.IsInteger())
+        {
+            const int64_t value = limit.AsInteger();
+            int64_t last = value;
+            if (isUntil && (step > 0 ? SubtractOverflows(value, 1, last) : AddOverflows(value, 1, last)))
+                return value;
+            return last;
+        }
+
+        const double value = limit.AsNumber();
+        if (std::isnan(value))
+            return step > 0 ? INT64_MIN : INT64_MAX;
+
+        double last;
+        if (step > 0)
+            last = isUntil ? std::ceil(value) - 1 : std::floor(value);
+        else
+            last = isUntil ? std::floor(value) + 1 : std::ceil(value);
+
+        if (last >= 0x1p63)
+            return INT64_MAX;
+        if (last <= -0x1p63)
+            return INT64_MIN;
+        return static_cast<int64_t>(last);
+    }
+
+    EvaluatedValue Visitor::GetIndex(const EvaluatedValue &object, const EvaluatedValue &index, const ListAccessNode &node)
+    {
+        if (object.IsList())
         {
-            if (auto indexDouble = std::get_if<double>(&indexVal))
+            if (index.IsNumber())
             {
-                int idx = static_cast<int>(*indexDouble);
-                auto &listElements = (*listWrapperPtr)->elements;
+                const int64_t idx = index.ToInteger();
+                auto &listElements = object.AsList().elements;
 
-                if (idx < 0 || idx >= listElements.size())
+                if (idx < 0 || idx >= static_cast<int64_t>(listElements.size()))
                     throw AlengError("List index " + std::to_string(idx) + " out of bounds for list of size " + std::to_string(listElements.size()), node);
 
                 return listElements[idx];
@@ -747,139 +824,206 @@ namespace Aleng
             else
                 throw AlengError("List index must be a number.", node);
         }
-        else if (auto mapWrapperPtr = std::get_if<MapStorage>(&listObjectVal))
+        else if (object.IsMap())
         {
-            if (auto pIndexStr = std::get_if<std::string>(&indexVal))
+            if (index.IsString())
             {
-                auto &mapElements = (*mapWrapperPtr)->elements;
-                auto it = mapElements.find(*pIndexStr);
+                auto &mapElements = object.AsMap().elements;
+                auto it = mapElements.find(index.AsStringStorage());
                 if (it == mapElements.end())
-                    throw AlengError("Key \"" + *pIndexStr + "\" not found in map.", *node.Index);
+                    throw AlengError("Key \"" + index.AsString() + "\" not found in map.", *node.Index);
                 return it->second;
             }
             else
                 throw AlengError("Map key must be a string.", *node.Index);
         }
         std::string objectName = "Object";
-        if (auto objIdNode = dynamic_cast<const IdentifierNode *>(node.Object.get()))
+        if (auto objIdNode = NodeCast<IdentifierNode>(node.Object.get()))
             objectName = "'" + objIdNode->Value + "'";
         throw AlengError(objectName + " is not an iterator, cannot perform indexed access.", node);
     }
     EvaluatedValue Visitor::Visit(const ReturnNode &node)
     {
-        EvaluatedValue resultVal = node.ReturnValueExpression->Accept(*this);
-        throw ReturnSignal(resultVal);
+        EvaluatedValue resultVal = node.ReturnValueExpression ? node.ReturnValueExpression->Accept(*this) : 0.0;
+        m_Completion = CompletionType::RETURN;
+        return resultVal;
     }
     EvaluatedValue Visitor::Visit(const BreakNode &node)
     {
-        throw BreakSignal();
+        m_Completion = CompletionType::BREAK;
+        return 0.0;
     }
     EvaluatedValue Visitor::Visit(const ContinueNode &node)
     {
-        throw ContinueSignal();
+        m_Completion = CompletionType::CONTINUE;
+        return 0.0;
     }
     EvaluatedValue Visitor::Visit(const AssignExpressionNode &node)
     {
         auto valueToAssign = node.Right->Accept(*this);
 
-        if (auto idNode = dynamic_cast<const IdentifierNode *>(node.Left.get()))
+        if (auto idNode = NodeCast<IdentifierNode>(node.Left.get()))
         {
-            AssignVariable(idNode->Value, valueToAssign);
+            AssignIdentifier(*idNode, valueToAssign);
             return valueToAssign;
         }
-        if (auto listAccess = dynamic_cast<const ListAccessNode *>(node.Left.get()))
+        if (auto listAccess = NodeCast<ListAccessNode>(node.Left.get()))
         {
             auto listObjectVal = listAccess->Object->Accept(*this);
             auto indexVal = listAccess->Index->Accept(*this);
 
-            if (auto listWrapperPtr = std::get_if<ListStorage>(&listObjectVal))
+            AssignIndex(listObjectVal, indexVal, valueToAssign, node);
+            return valueToAssign;
+        }
+        if (auto memberAccess = NodeCast<MemberAccessNode>(node.Left.get()))
+        {
+            auto objectVal = memberAccess->Object->Accept(*this);
+
+            AssignMember(objectVal, valueToAssign, node);
+            return valueToAssign;
+        }
+
+        throw AlengError("Invalid left-hand side in assignment.", node);
+    }
+
+    void Visitor::AssignIdentifier(const IdentifierNode &node, const EvaluatedValue &value)
+    {
+        if (node.Binding.IsGlobal())
+        {
+            AssignVariable(node.Value, value, node);
+            return;
+        }
+
+        // Until a local is first assigned, an existing global of the same name takes the write.
+        auto &storage = BindingStorage(node.Binding);
+        if (!storage && TryAssignGlobal(node.Value, value))
+            return;
+        storage = value;
+    }
+
+    bool Visitor::TryAssignGlobal(const std::string &name, const EvaluatedValue &value) const
+    {
+        for (const auto &scope : std::ranges::reverse_view(*m_SymbolTableStack))
+        {
+            if (const auto it = scope->find(name); it != scope->end())
             {
-                if (auto indexDouble = std::get_if<double>(&indexVal))
-                {
-                    int idx = static_cast<int>(*indexDouble);
-                    auto &listElements = (*listWrapperPtr)->elements;
-                    if (idx < 0 || idx >= listElements.size())
-                        throw AlengError("List index " + std::to_string(idx) + " out of bounds for list of size " + std::to_string(listElements.size()), node);
-                    listElements[idx] = valueToAssign;
-                    return valueToAssign;
-                }
-                else
-                    throw AlengError("List index must be a number.", node);
+                it->second = value;
+                return true;
             }
-            else if (auto mapWrapperPtr = std::get_if<MapStorage>(&listObjectVal))
+        }
+        return false;
+    }
+
+    void Visitor::AssignIndex(const EvaluatedValue &object, const EvaluatedValue &index, const EvaluatedValue &value, const AssignExpressionNode &node)
+    {
+        const auto listAccess = static_cast<const ListAccessNode *>(node.Left.get());
+
+        if (object.IsList())
+        {
+            if (index.IsNumber())
             {
-                if (auto pIndexStr = std::get_if<std::string>(&indexVal))
-                {
-                    (*mapWrapperPtr)->elements[*pIndexStr] = valueToAssign;
-                    return valueToAssign;
-                }
-                else
-                    throw AlengError("Map key for assignment must be a string.", *listAccess->Index);
+                const int64_t idx = index.ToInteger();
+                auto &listElements = object.AsList().elements;
+                if (idx < 0 || idx >= static_cast<int64_t>(listElements.size()))
+                    throw AlengError("List index " + std::to_string(idx) + " out of bounds for list of size " + std::to_string(listElements.size()), node);
+                listElements[idx] = value;
+                return;
             }
             else
+                throw AlengError("List index must be a number.", node);
+        }
+        else if (object.IsMap())
+        {
+            if (index.IsString())
             {
-                std::string objectName = "Object";
-                if (auto objIdNode = dynamic_cast<const IdentifierNode *>(listAccess->Object.get()))
-                    objectName = "'" + objIdNode->Value + "'";
-                throw AlengError(objectName + " is not a iterator, cannot perform indexed assignment.", node);
+                auto &map = object.AsMap();
+                const auto key = index.AsStringStorage();
+                if (const auto it = map.elements.find(key); it != map.elements.end())
+                    it->second = value;
+                else
+                {
+                    CheckMemoryLimit(node, map.elements.InsertBytes());
+                    map.elements[key] = value;
+                    map.UpdateCharge();
+                }
+                return;
             }
+            else
+                throw AlengError("Map key for assignment must be a string.", *listAccess->Index);
         }
-        if (auto memberAccess = dynamic_cast<const MemberAccessNode *>(node.Left.get()))
+        else
         {
-            auto objectVal = memberAccess->Object->Accept(*this);
-            const std::string& memberName = memberAccess->MemberIdentifier.Value;
+            std::string objectName = "Object";
+            if (auto objIdNode = NodeCast<IdentifierNode>(listAccess->Object.get()))
+                objectName = "'" + objIdNode->Value + "'";
+            throw AlengError(objectName + " is not a iterator, cannot perform indexed assignment.", node);
+        }
+    }
 
-            if (auto mapWrapperPtr = std::get_if<MapStorage>(&objectVal))
+    void Visitor::AssignMember(const EvaluatedValue &object, const EvaluatedValue &value, const AssignExpressionNode &node)
+    {
+        const auto memberAccess = static_cast<const MemberAccessNode *>(node.Left.get());
+        if (object.IsMap())
+        {
+            auto &map = object.AsMap();
+            if (const auto it = map.elements.find(memberAccess->Interned(), memberAccess->Cache); it != map.elements.end())
+                it->second = value;
+            else
             {
-                (*mapWrapperPtr)->elements[memberName] = valueToAssign;
-                return valueToAssign;
+                CheckMemoryLimit(node, map.elements.InsertBytes());
+                map.elements[memberAccess->Interned()] = value;
+                map.UpdateCharge();
             }
-
-            std::string objectTypeName = AlengTypeToString(GetAlengType(objectVal));
-            throw AlengError("Cannot assign to a member of a non-map type ('" + objectTypeName + "').", *memberAccess->Object);
+            return;
         }
 
-        throw AlengError("Invalid left-hand side in assignment.", node);
+        std::string objectTypeName = AlengTypeToString(GetAlengType(object));
+        throw AlengError("Cannot assign to a member of a non-map type ('" + objectTypeName + "').", *memberAccess->Object);
     }
 
     EvaluatedValue Visitor::Visit(const MemberAccessNode &node)
     {
         const auto objectVal = node.Object->Accept(*this);
-        const std::string& memberName = node.MemberIdentifier.Value;
+        return GetMember(objectVal, node);
+    }
 
-        if (const auto mapWrapperPtr = std::get_if<MapStorage>(&objectVal))
+    EvaluatedValue Visitor::GetMember(const EvaluatedValue &object, const MemberAccessNode &node)
+    {
+        const std::string& memberName = node.MemberName;
+
+        if (object.IsMap())
         {
+            auto &mapElements = object.AsMap().elements;
             if (memberName == "length")
             {
-                return static_cast<double>((*mapWrapperPtr)->elements.size());
+                return static_cast<int64_t>(mapElements.size());
             }
 
-            auto &mapElements = (*mapWrapperPtr)->elements;
-            const auto it = mapElements.find(memberName);
+            const auto it = mapElements.find(node.Interned(), node.Cache);
             if (it == mapElements.end())
                 throw AlengError("Member \"" + memberName + "\" not found in map.", node);
             return it->second;
         }
 
-        if (const auto listWrapperPtr = std::get_if<ListStorage>(&objectVal))
+        if (object.IsList())
         {
             if (memberName == "length")
             {
-                return static_cast<double>((*listWrapperPtr)->elements.size());
+                return static_cast<int64_t>(object.AsList().elements.size());
             }
         }
 
-        if (const auto strPtr = std::get_if<std::string>(&objectVal))
+        if (object.IsString())
         {
             if (memberName == "length")
             {
-                return static_cast<double>(strPtr->size());
+                return static_cast<int64_t>(object.AsStringStorage()->Length());
             }
 
             throw AlengError("Member \"" + memberName + "\" not found in string.", *node.Object);
         }
 
-        const std::string objectTypeName = AlengTypeToString(GetAlengType(objectVal));
+        const std::string objectTypeName = AlengTypeToString(GetAlengType(object));
         throw AlengError("Member access operator '.' cannot be used on type '" + objectTypeName + "'.", *node.Object);
     }
 
@@ -888,37 +1032,7 @@ namespace Aleng
         auto left = node.Left->Accept(*this);
         auto right = node.Right->Accept(*this);
 
-        bool areEqual = false;
-
-        std::visit(overloads{[&](double l, double r)
-                             {
-                                 areEqual = l == r;
-                             },
-                             [&](std::string l, std::string r)
-                             {
-                                 areEqual = l == r;
-                             },
-                             [&](bool l, bool r)
-                             {
-                                 areEqual = l == r;
-                             },
-                             [&](MapStorage l, MapStorage r)
-                             {
-                                 areEqual = (l->elements == r->elements);
-                             },
-                             [&](ListStorage l, ListStorage r)
-                             {
-                                 areEqual = (l->elements == r->elements);
-                             },
-                             [&](const FunctionStorage &l, const FunctionStorage &r)
-                             {
-                                 areEqual = l->Name == r->Name;
-                             },
-                             [&](auto &l, auto &r)
-                             {
-                                 throw AlengError("Invalid types for equality comparison.", node);
-                             }},
-                   left, right);
+        const bool areEqual = AreEqual(left, right, node);
 
         if (node.Inverse)
             return !areEqual;
@@ -926,22 +1040,71 @@ namespace Aleng
             return areEqual;
     }
 
+    bool Visitor::AreEqual(const EvaluatedValue &left, const EvaluatedValue &right, const ASTNode &node)
+    {
+        if (left.IsInteger() && right.IsInteger())
+            return left.AsInteger() == right.AsInteger();
+        if (left.IsNumber() && right.IsNumber())
+            return left.AsNumber() == right.AsNumber();
+        if (left.IsString() && right.IsString())
+            return left.AsString() == right.AsString();
+        if (left.IsBool() && right.IsBool())
+            return left.AsBool() == right.AsBool();
+        if (left.IsMap() && right.IsMap())
+        {
+            // Equal keys need not be the same string object, so look each one up rather than comparing entries.
+            const auto &leftElements = left.AsMap().elements;
+            const auto &rightElements = right.AsMap().elements;
+            if (leftElements.size() != rightElements.size())
+                return false;
+            for (const auto &[key, value] : leftElements)
+            {
+                const auto it = rightElements.find(key);
+                if (it == rightElements.end() || !(it->second == value))
+                    return false;
+            }
+            return true;
+        }
+        if (left.IsList() && right.IsList())
+            return left.AsList().elements == right.AsList().elements;
+        if (left.IsFunction() && right.IsFunction())
+            return left.AsFunction().Name == right.AsFunction().Name;
+
+        throw AlengError("Invalid types for equality comparison.", node);
+    }
+
     EvaluatedValue Visitor::Visit(const FunctionDefinitionNode &node)
     {
         std::string internalName = node.FunctionName.value_or("lambda@" + std::to_string(node.Location.Start.Line));
 
-        auto funcNodeCopy = std::make_shared<FunctionDefinitionNode>(node);
-        SymbolTableStack currentEnv = m_SymbolTableStack;
+        // Alias into the running program's AST instead of copying the body.
+        auto funcNode = m_AstOwner
+            ? std::shared_ptr<const FunctionDefinitionNode>(m_AstOwner, &node)
+            : std::make_shared<FunctionDefinitionNode>(node);
+
+        // Only the variables the body actually uses are captured, as shared cells.
+        std::vector<CellPtr> upvalues;
+        upvalues.reserve(node.Captures.size());
+        for (const auto &capture : node.Captures)
+            upvalues.push_back(capture.FromEnclosingCell ? m_Cells[m_CellBase + capture.Index] : (*m_Upvalues)[capture.Index]);
 
-        auto functionStorage = std::make_shared<FunctionObject>(internalName, funcNodeCopy, currentEnv);
+        auto functionStorage = MakeRef<FunctionObject>(internalName, std::move(funcNode), m_SymbolTableStack, std::move(upvalues));
 
         if (node.FunctionName)
         {
-            if (IsVariableDefinedInCurrentScope(*node.FunctionName))
+            if (!node.NameBinding.IsGlobal())
             {
-                throw AlengError("Identifier '" + *node.FunctionName + "' already defined in this scope.", node);
+                auto &storage = BindingStorage(node.NameBinding);
+                if (storage)
+                    throw AlengError("Identifier '" + *node.FunctionName + "' already defined in this scope.", node);
+                storage = functionStorage;
+            }
+            else
+            {
+                if (IsVariableDefinedInCurrentScope(*node.FunctionName))
+                    throw AlengError("Identifier '" + *node.FunctionName + "' already defined in this scope.", node);
+                (*m_SymbolTableStack->back())[InternString(*node.FunctionName)] = functionStorage;
             }
-            (*m_SymbolTableStack.back())[*node.FunctionName] = functionStorage;
         }
 
         return functionStorage;
@@ -950,55 +1113,64 @@ namespace Aleng
     EvaluatedValue Visitor::Visit(const FunctionCallNode &node)
     {
         EvaluatedValue callableVar = node.CallableExpression->Accept(*this);
-        auto pFuncObj = std::get_if<FunctionStorage>(&callableVar);
-
-        if (!pFuncObj)
+        if (!callableVar.IsFunction())
         {
             std::stringstream ss;
             node.CallableExpression->Print(ss);
             throw AlengError("Expression '" + ss.str() + "' is not callable.", node);
         }
 
-        const FunctionObject &funcObj = *pFuncObj->get();
-
         std::vector<EvaluatedValue> resolvedArgs;
 
         for (auto &p : node.Arguments)
             resolvedArgs.push_back(p->Accept(*this));
 
+        return CallFunction(callableVar.AsFunction(), resolvedArgs, node);
+    }
+
+    EvaluatedValue Visitor::CallFunction(const FunctionObject &funcObj, const std::vector<EvaluatedValue> &resolvedArgs, const FunctionCallNode &node)
+    {
+        // Hosts may call in directly, so the account is made active here as well as in Execute.
+        MemoryAccount::Scope memoryScope(m_Memory);
+        CheckMemoryLimit(node);
+        ConsumeStep(node);
+
         if (funcObj.Type == FunctionObject::Type::USER_DEFINED)
         {
             if (!funcObj.UserFuncNodeAst)
                 throw AlengError("Internal error: User-defined FunctionObject has no AST node for '" + funcObj.Name + "'.", node);
 
-            ScopedEnvironmentSwap swapGuard(m_SymbolTableStack, funcObj.CapturedEnvironment);
-
-            PushScope();
-
             const auto &funcDef = *funcObj.UserFuncNodeAst;
 
+            ScopedAstOwner ownerGuard(m_AstOwner, funcObj.UserFuncNodeAst);
+            CallFrameScope frame(*this, funcObj.Globals, &funcObj.Upvalues, funcDef.LocalCount, funcDef.CellCount);
+
             size_t argIdx = 0;
             bool variadicProcessed = false;
 
             auto funcName = funcDef.FunctionName.value_or("lambda@" + std::to_string(funcDef.Location.Start.Line));
 
-            for (const auto &param : funcDef.Parameters)
+            for (size_t paramIdx = 0; paramIdx < funcDef.Parameters.size(); paramIdx++)
             {
+                const auto &param = funcDef.Parameters[paramIdx];
                 if (param.IsVariadic)
                 {
-                    auto variadicList = std::make_shared<ListRecursiveWrapper>();
+                    const size_t count = resolvedArgs.size() - std::min(argIdx, resolvedArgs.size());
+                    CheckMemoryLimit(node, ListRecursiveWrapper::BytesFor(count));
+                    auto variadicList = MakeRef<ListRecursiveWrapper>();
+                    variadicList->elements.reserve(count);
                     for (size_t i = argIdx; i < resolvedArgs.size(); ++i)
                     {
                         variadicList->elements.push_back(resolvedArgs[i]);
                     }
-                    DefineVariable(param.Name, variadicList, false);
+                    variadicList->UpdateCharge();
+                    BindingStorage(funcDef.ParameterBindings[paramIdx]) = std::move(variadicList);
                     variadicProcessed = true;
                     break;
                 }
 
                 if (argIdx >= resolvedArgs.size())
                 {
-                    PopScope();
                     throw AlengError("Not enough arguments for function '" + funcName + "'. Expected parameter '" + param.Name + "'.", node);
                 }
 
@@ -1014,14 +1186,12 @@ namespace Aleng
                         expectedType = AlengType::ANY;
                     else
                     {
-                        PopScope();
                         throw AlengError("Unknown type name '" + *param.TypeName + "' in function '" + funcName + "' signature for parameter '" + param.Name + "'.", node);
                     }
 
                     AlengType actualType = GetAlengType(argVal);
                     if (actualType != expectedType)
                     {
-                        PopScope();
                         throw AlengError("Type mismatch for parameter '" + param.Name + "' in function '" + funcName +
                                              "'. Expected " + *param.TypeName + " (" + AlengTypeToString(expectedType) +
                                              ") but got " + AlengTypeToString(actualType) + ".",
@@ -1029,44 +1199,32 @@ namespace Aleng
                     }
                 }
 
-                DefineVariable(param.Name, argVal, false);
+                BindingStorage(funcDef.ParameterBindings[paramIdx]) = argVal;
                 argIdx++;
             }
 
             if (!variadicProcessed && argIdx < resolvedArgs.size())
             {
-                PopScope();
                 throw AlengError("Too many arguments for function '" + funcName + "'. Expected " + std::to_string(funcDef.Parameters.size()) + " arguments, got " + std::to_string(resolvedArgs.size()) + ".", node);
             }
 
             EvaluatedValue result;
 
-            try
+            if (m_ExecutionMode == ExecutionMode::BYTECODE)
             {
-                funcDef.Body->Accept(*this);
-            }
-            catch (const ReturnSignal &signal)
-            {
-                result = signal.Value;
-            }
-            catch (...)
-            {
-                std::exception_ptr p = std::current_exception();
-                try {
-                    if (p) std::rethrow_exception(p);
-                }
-                catch (const ReturnSignal &signal) {
-                    result = signal.Value;
-                }
-                catch (const std::exception& _) {
-                    throw;
-                }
-                catch (...) {
-                    throw AlengError("Critical: Unknown exception thrown inside function.", node);
-                }
+                result = m_VM->Execute(funcObj);
+                return result;
             }
 
-            PopScope();
+            auto bodyResult = funcDef.Body->Accept(*this);
+
+            const auto completion = m_Completion;
+            m_Completion = CompletionType::NORMAL;
+
+            if (completion == CompletionType::RETURN)
+                result = std::move(bodyResult);
+            else if (completion != CompletionType::NORMAL)
+                throw AlengError(completion == CompletionType::BREAK ? "'Break' used outside of a loop." : "'Continue' used outside of a loop.", funcDef);
 
             return result;
         }
@@ -1077,7 +1235,7 @@ namespace Aleng
             {
                 throw AlengError("Internal error: Built-in function '" + funcObj.Name + "' not found.", node);
             }
-            return it->second(*this, resolvedArgs, node);
+            return it->second.Callback(*this, resolvedArgs, node);
         }
 
         throw AlengError("Internal error: Unknown FunctionObject type.", node);
@@ -1106,117 +1264,182 @@ namespace Aleng
         auto left = node.Left->Accept(*this);
         auto right = node.Right->Accept(*this);
 
-        EvaluatedValue finalValue;
+        return BinaryOperation(node.Operator, left, right, node);
+    }
 
-        std::visit(
-            overloads{
-                [&](double l, double r)
-                {
-                    switch (node.Operator)
-                    {
-                    case TokenType::PLUS:
-                        finalValue = EvaluatedValue(l + r);
-                        break;
-                    case TokenType::MINUS:
-                        finalValue = EvaluatedValue(l - r);
-                        break;
-                    case TokenType::MULTIPLY:
-                        finalValue = EvaluatedValue(l * r);
-                        break;
-                    case TokenType::DIVIDE:
-                        if (r == 0.0)
-                            throw AlengError("Division by 0  is an error.", node);
-                        finalValue = EvaluatedValue(l / r);
-                        break;
-                    case TokenType::MODULO:
-                        if (r == 0.0)
-                            throw AlengError("Modulo by 0  is an error.", node);
-                        finalValue = EvaluatedValue(std::fmod(l, r));
-                        break;
-                    case TokenType::GREATER:
-                        finalValue = EvaluatedValue(l > r);
-                        break;
-                    case TokenType::GREATER_EQUAL:
-                        finalValue = EvaluatedValue(l >= r);
-                        break;
-                    case TokenType::MINOR:
-                        finalValue = EvaluatedValue(l < r);
-                        break;
-                    case TokenType::MINOR_EQUAL:
-                        finalValue = EvaluatedValue(l <= r);
-                        break;
-                    default:
-                        throw AlengError("Unknown operator for binary expression: " + TokenTypeToString(node.Operator), node);
-                    }
-                },
-                [&](std::string l, std::string r)
-                {
-                    switch (node.Operator)
-                    {
-                    case TokenType::PLUS:
-                        finalValue = EvaluatedValue(l + r);
-                            break;
-                    case TokenType::GREATER:
-                        finalValue = EvaluatedValue(l > r);
-                        break;
-                    case TokenType::GREATER_EQUAL:
-                        finalValue = EvaluatedValue(l >= r);
-                        break;
-                    case TokenType::MINOR:
-                        finalValue = EvaluatedValue(l < r);
-                        break;
-                    case TokenType::MINOR_EQUAL:
-                        finalValue = EvaluatedValue(l <= r);
-                        break;
-                    default:
-                        throw AlengError("Only concatenation operator for strings supported.", node);
-                    }
-                },
-                [&](std::string l, double r)
-                {
-                    auto ss = std::stringstream();
+    EvaluatedValue Visitor::BinaryOperation(const TokenType op, const EvaluatedValue &left, const EvaluatedValue &right, const ASTNode &node)
+    {
+        // Integers stay integers unless the result overflows or, for division, is not whole;
+        // those cases fall through to the double arithmetic below.
+        if (left.IsInteger() && right.IsInteger())
+        {
+            const int64_t l = left.AsInteger();
+            const int64_t r = right.AsInteger();
+            int64_t result;
+            switch (op)
+            {
+            case TokenType::PLUS:
+                if (!AddOverflows(l, r, result))
+                    return result;
+                break;
+            case TokenType::MINUS:
+                if (!SubtractOverflows(l, r, result))
+                    return result;
+                break;
+            case TokenType::MULTIPLY:
+                if (!MultiplyOverflows(l, r, result))
+                    return result;
+                break;
+            case TokenType::DIVIDE:
+                if (r == -1 && !SubtractOverflows(0, l, result))
+                    return result;
+                if (r != 0 && r != -1 && l % r == 0)
+                    return l / r;
+                break;
+            case TokenType::MODULO:
+                if (r == 0)
+                    throw AlengError("Modulo by 0  is an error.", node);
+                return r == -1 ? 0 : l % r;
+            case TokenType::GREATER:
+                return l > r;
+            case TokenType::GREATER_EQUAL:
+                return l >= r;
+            case TokenType::MINOR:
+                return l < r;
+            case TokenType::MINOR_EQUAL:
+                return l <= r;
+            default:
+                break;
+            }
+        }
 
-                    switch (node.Operator)
-                    {
-                    case TokenType::PLUS:
-                        ss << l;
-                        ss << std::to_string(r);
-                        finalValue = ss.str();
-                        break;
-                    case TokenType::MULTIPLY:
-                        for (int i = 0; i < static_cast<int>(r); i++)
-                            ss << l;
-                        finalValue = ss.str();
-                        break;
-                    default:
-                        throw AlengError("Unknown operator for binary expression: " + TokenTypeToString(node.Operator), node);
-                    }
-                },
-                [&](ListStorage l, ListStorage r)
-                {
-                    auto finalList = std::make_shared<ListRecursiveWrapper>();
+        if (left.IsNumber() && right.IsNumber())
+        {
+            const double l = left.AsNumber();
+            const double r = right.AsNumber();
+            switch (op)
+            {
+            case TokenType::PLUS:
+                return l + r;
+            case TokenType::MINUS:
+                return l - r;
+            case TokenType::MULTIPLY:
+                return l * r;
+            case TokenType::DIVIDE:
+                if (r == 0.0)
+                    throw AlengError("Division by 0  is an error.", node);
+                return l / r;
+            case TokenType::MODULO:
+                if (r == 0.0)
+                    throw AlengError("Modulo by 0  is an error.", node);
+                return std::fmod(l, r);
+            case TokenType::GREATER:
+                return l > r;
+            case TokenType::GREATER_EQUAL:
+                return l >= r;
+            case TokenType::MINOR:
+                return l < r;
+            case TokenType::MINOR_EQUAL:
+                return l <= r;
+            default:
+                throw AlengError("Unknown operator for binary expression: " + TokenTypeToString(op), node);
+            }
+        }
 
-                    for (const auto& elem : l->elements)
-                    {
-                        finalList->elements.push_back(elem);
-                    }
-                    for (const auto& elem : r->elements)
-                    {
-                        finalList->elements.push_back(elem);
-                    }
+        if (left.IsString() && right.IsString())
+        {
+            if (op == TokenType::PLUS)
+            {
+                // Counts the text a rope holds once flattened, as well as the node.
+                CheckMemoryLimit(node, sizeof(StringObject) + left.AsStringStorage()->Length() + right.AsStringStorage()->Length());
+                return ConcatStrings(left.AsStringStorage(), right.AsStringStorage());
+            }
 
-                    finalValue = EvaluatedValue(finalList);
-                },
-                [&](auto &l, auto &r)
-                {
-                    throw AlengError("Unsupported operand types for operator " + TokenTypeToString(node.Operator) +
-                                         ". Left type: " + AlengTypeToString(GetAlengType(left)) +
-                                         ", Right type: " + AlengTypeToString(GetAlengType(right)),
-                                     node);
-                }},
-            left, right);
-
-        return finalValue;
+            const auto &l = left.AsString();
+            const auto &r = right.AsString();
+            switch (op)
+            {
+            case TokenType::GREATER:
+                return l > r;
+            case TokenType::GREATER_EQUAL:
+                return l >= r;
+            case TokenType::MINOR:
+                return l < r;
+            case TokenType::MINOR_EQUAL:
+                return l <= r;
+            default:
+                throw AlengError("Only concatenation operator for strings supported.", node);
+            }
+        }
+
+        if (left.IsString() && right.IsNumber())
+        {
+            const auto &l = left.AsString();
+            const double r = right.AsNumber();
+            auto ss = std::stringstream();
+
+            // The number is at most 32 characters once formatted.
+            CheckMemoryLimit(node, 2 * sizeof(StringObject) + l.size() + 32);
+            switch (op)
+            {
+            case TokenType::PLUS:
+                return ConcatStrings(left.AsStringStorage(),
+                                     MakeRef<StringObject>(right.IsInteger() ? std::to_string(right.AsInteger()) : std::to_string(r)));
+            case TokenType::MULTIPLY:
+                // The repetition is built before it can be charged, so refuse one that would not fit.
+                if (r > 0)
+                    CheckMemoryLimit(node, static_cast<size_t>(std::min(r, 0x1p62) * static_cast<double>(l.size())));
+                for (int i = 0; i < static_cast<int>(r); i++)
+                    ss << l;
+                return ss.str();
+            default:
+                throw AlengError("Unknown operator for binary expression: " + TokenTypeToString(op), node);
+            }
+        }
+
+        if (left.IsList() && right.IsList())
+        {
+            const size_t count = left.AsList().elements.size() + right.AsList().elements.size();
+            CheckMemoryLimit(node, ListRecursiveWrapper::BytesFor(count));
+            auto finalList = MakeRef<ListRecursiveWrapper>();
+            finalList->elements.reserve(count);
+
+            for (const auto& elem : left.AsList().elements)
+            {
+                finalList->elements.push_back(elem);
+            }
+            for (const auto& elem : right.AsList().elements)
+            {
+                finalList->elements.push_back(elem);
+            }
+            finalList->UpdateCharge();
+            return finalList;
+        }
+
+        throw AlengError("Unsupported operand types for operator " + TokenTypeToString(op) +
+                             ". Left type: " + AlengTypeToString(GetAlengType(left)) +
+                             ", Right type: " + AlengTypeToString(GetAlengType(right)),
+                         node);
+    }
+
+    void Visitor::ThrowExecutionInterrupted(const ASTNode &node)
+    {
+        if (m_InterruptRequested.exchange(false, std::memory_order_relaxed))
+        {
+            // The step was not taken.
+            m_StepsLeft++;
+            throw ExecutionInterrupted(ExecutionInterrupted::Reason::INTERRUPT_REQUESTED, node);
+        }
+        // Stay exhausted without drifting further below zero on every later check.
+        m_StepsLeft = 0;
+        throw ExecutionInterrupted(ExecutionInterrupted::Reason::STEP_BUDGET_EXHAUSTED, node);
+    }
+
+    void Visitor::ThrowMemoryLimitExceeded(const ASTNode &node, const size_t bytes)
+    {
+        const auto usage = MemoryAccount::Active()->GetUsage();
+        throw AlengError("Memory limit of " + std::to_string(usage.Limit) + " bytes exceeded (" +
+                             std::to_string(usage.Current) + " bytes in use, " + std::to_string(bytes) + " more needed).", node);
     }
 
     EvaluatedValue Visitor::Visit(const UnaryExpressionNode &node)
@@ -1229,4 +1452,4 @@ namespace Aleng
 
         throw AlengError("Unsupported unary operator '" + TokenTypeToString(node.Operator) + "'.", node);
     }
-}
\ No newline at end of file
+}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "AST.h"
+#include <atomic>
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 #include <functional>
 #include <memory>
+#include <optional>
 
+#include "ControlFlow.h"
 #include "Modules/NativeModule.h"
 
 namespace Aleng
@@ -24,13 +28,54 @@ namespace Aleng
     };
     std::string AlengTypeToString(AlengType type);
 
+    class VM;
+
+    enum class ExecutionMode
+    {
+        TREE_WALK,
+        BYTECODE
+    };
+
     class Visitor
     {
     public:
-        explicit Visitor(ModuleManager& moduleManager);
+        explicit Visitor(ModuleManager& moduleManager, ExecutionMode mode = ExecutionMode::BYTECODE);
+        ~Visitor();
+
+        // A fresh interpreter with this one's builtins and global bindings, without re-running setup.
+        // The fork gets its own copy of every global, including the lists, maps and closures they reach, so
+        // neither side sees the other's changes. Use a fork on the thread that owns the snapshot: the copy
+        // still shares strings with it, and values, interned strings and the collector's heap all belong to
+        // the thread that created them. Interpreters created separately can run on separate threads.
+        [[nodiscard]] std::unique_ptr<Visitor> Fork(ModuleManager& moduleManager) const;
 
         static EvaluatedValue ExecuteAlengFile(const std::string &filepath, Visitor &visitor);
 
+        // Runs a whole program with the selected execution engine.
+        EvaluatedValue Execute(std::shared_ptr<ProgramNode> program);
+        EvaluatedValue CallFunction(const FunctionObject &function, const std::vector<EvaluatedValue> &args, const FunctionCallNode &ctx);
+
+        void SetExecutionMode(const ExecutionMode mode) { m_ExecutionMode = mode; }
+        [[nodiscard]] ExecutionMode GetExecutionMode() const { return m_ExecutionMode; }
+
+        // Bytes held by the values, global scopes and call frames this interpreter allocated. A call or allocation
+        // that would go over the limit raises an AlengError first; 0 removes the limit. Forks inherit the limit.
+        void SetMemoryLimit(const size_t bytes) { m_Memory->SetLimit(bytes); }
+        [[nodiscard]] MemoryUsage GetMemoryUsage() const { return m_Memory->GetUsage(); }
+
+        // Every loop iteration and every call is one step. Once the steps given here are used up, the run
+        // unwinds with ExecutionInterrupted; later runs stop at once until a new budget is set. 0 removes the budget.
+        void SetStepBudget(const uint64_t steps)
+        {
+            m_StepBudget = steps == 0 || steps > INT64_MAX ? INT64_MAX : static_cast<int64_t>(steps);
+            m_StepsLeft = m_StepBudget;
+        }
+        // Steps taken since the budget was last set.
+        [[nodiscard]] uint64_t GetStepsTaken() const { return static_cast<uint64_t>(m_StepBudget - m_StepsLeft); }
+        // Safe to call from any thread. The running script stops with ExecutionInterrupted at its next step;
+        // if none is running, the next one does. The request is cleared once it has stopped a run.
+        void RequestInterrupt() { m_InterruptRequested.store(true, std::memory_order_relaxed); }
+
         void RegisterBuiltinCallback(const std::string& name, BuiltinFunctionCallback callback);
 
         EvaluatedValue Visit(const ProgramNode &node);
@@ -42,6 +87,7 @@ namespace Aleng
         EvaluatedValue Visit(const MapNode &node);
 
         EvaluatedValue ExecuteAndStoreModule(const std::string &sourceCode, const ImportModuleNode &node, const std::string &modulePath);
+        EvaluatedValue ExecuteAndStoreModule(std::shared_ptr<ProgramNode> ast, const ImportModuleNode &node);
 
 
 
@@ -52,13 +98,13 @@ namespace Aleng
         static EvaluatedValue Visit(const FloatNode &node);
 
         static EvaluatedValue Visit(const StringNode &node);
-        EvaluatedValue Visit(const IdentifierNode &node) const;
+        EvaluatedValue Visit(const IdentifierNode &node);
         EvaluatedValue Visit(const ListAccessNode &node);
         EvaluatedValue Visit(const ReturnNode &node);
 
-        static EvaluatedValue Visit(const BreakNode &node);
+        EvaluatedValue Visit(const BreakNode &node);
 
-        static EvaluatedValue Visit(const ContinueNode &node);
+        EvaluatedValue Visit(const ContinueNode &node);
         EvaluatedValue Visit(const AssignExpressionNode &node);
         EvaluatedValue Visit(const MemberAccessNode & node);
         EvaluatedValue Visit(const FunctionDefinitionNode &node);
@@ -69,12 +115,64 @@ namespace Aleng
         EvaluatedValue Visit(const EqualsExpressionNode &node);
 
     private:
+        friend class VM;
+
+        Visitor(const Visitor& snapshot, ModuleManager& moduleManager);
+
         static AlengType GetAlengType(const EvaluatedValue &val);
+
+        bool ShouldExitLoop();
+
+        // Raises once the running interpreter's values are over its memory limit, or would be after
+        // allocating the given number of bytes.
+        static void CheckMemoryLimit(const ASTNode &node, const size_t bytes = 0)
+        {
+            if (const auto *account = MemoryAccount::Active(); account && !account->CanCharge(bytes)) [[unlikely]]
+                ThrowMemoryLimitExceeded(node, bytes);
+        }
+        [[noreturn]] static void ThrowMemoryLimitExceeded(const ASTNode &node, size_t bytes);
+
+        // Counts a step at a loop back-edge or call and polls for an interrupt.
+        void ConsumeStep(const ASTNode &node)
+        {
+            if (--m_StepsLeft < 0 || m_InterruptRequested.load(std::memory_order_relaxed)) [[unlikely]]
+                ThrowExecutionInterrupted(node);
+        }
+        [[noreturn]] void ThrowExecutionInterrupted(const ASTNode &node);
+
+        // Operation semantics shared by the tree walker and the bytecode VM.
+        EvaluatedValue LookupIdentifier(const IdentifierNode &node);
+        void AssignIdentifier(const IdentifierNode &node, const EvaluatedValue &value);
+        bool TryAssignGlobal(const std::string &name, const EvaluatedValue &value) const;
+        static EvaluatedValue BinaryOperation(TokenType op, const EvaluatedValue &left, const EvaluatedValue &right, const ASTNode &node);
+        static bool AreEqual(const EvaluatedValue &left, const EvaluatedValue &right, const ASTNode &node);
+        // Last counter value a numeric For loop visits, so each iteration tests one integer comparison.
+        static int64_t LastLoopValue(const EvaluatedValue &limit, int64_t step, bool isUntil);
+        static EvaluatedValue GetIndex(const EvaluatedValue &object, const EvaluatedValue &index, const ListAccessNode &node);
+        static EvaluatedValue GetMember(const EvaluatedValue &object, const MemberAccessNode &node);
+        static void AssignIndex(const EvaluatedValue &object, const EvaluatedValue &index, const EvaluatedValue &value, const AssignExpressionNode &node);
+        static void AssignMember(const EvaluatedValue &object, const EvaluatedValue &value, const AssignExpressionNode &node);
+        // Storage the Resolver assigned to a non-global binding in the running frame.
+        std::optional<EvaluatedValue> &BindingStorage(const VariableBinding &binding)
+        {
+            switch (binding.Kind)
+            {
+            case BindingKind::LOCAL:
+                return m_Locals[m_LocalBase + binding.Index];
+            case BindingKind::CELL:
+                return m_Cells[m_CellBase + binding.Index]->Value;
+            default:
+                return (*m_Upvalues)[binding.Index]->Value;
+            }
+        }
+        void EnterScope(const ScopeRange &range);
+
+        class CallFrameScope;
     public:
         void PushScope();
         void PopScope();
         void DefineVariable(const std::string &name, const EvaluatedValue &value, bool allowRedefinitionCurrentScope = true);
-        void AssignVariable(const std::string& name, const EvaluatedValue& value) const;
+        void AssignVariable(const std::string& name, const EvaluatedValue& value, const ASTNode& node) const;
         EvaluatedValue LookupVariable(const std::string &name);
         bool IsVariableDefinedInCurrentScope(const std::string &name) const;
     private:
@@ -97,10 +195,36 @@ namespace Aleng
             explicit Callable(BuiltinFunctionCallback func) : type(Type::BUILTIN), builtinFunc(std::move(func)) {}
         };
 
-        SymbolTableStack m_SymbolTableStack;
-        std::unordered_map<std::string, BuiltinFunctionCallback> m_NativeCallbacks;
+        // Name-based program and module scopes. Closures share the stack and it is replaced, not mutated, on push/pop.
+        std::shared_ptr<const SymbolTableStack> m_SymbolTableStack;
+        // Function and loop locals: one flat frame per call, starting at the bases.
+        std::vector<std::optional<EvaluatedValue>> m_Locals;
+        size_t m_LocalBase = 0;
+        std::vector<CellPtr> m_Cells;
+        size_t m_CellBase = 0;
+        const std::vector<CellPtr> *m_Upvalues = nullptr;
+        // Owner of the AST currently executing; function objects alias into it rather than cloning nodes.
+        std::shared_ptr<const void> m_AstOwner;
+        struct NativeFunction
+        {
+            BuiltinFunctionCallback Callback;
+            // Handed out for every lookup of the name, so calling a builtin does not allocate.
+            FunctionStorage Object;
+        };
+        std::unordered_map<std::string, NativeFunction> m_NativeCallbacks;
 
         ModuleManager& m_ModuleManager;
+        // Shared with every value charged to it; released, not deleted, with the Visitor.
+        MemoryAccount *m_Memory;
+
+        CompletionType m_Completion = CompletionType::NORMAL;
+
+        int64_t m_StepBudget = INT64_MAX;
+        int64_t m_StepsLeft = INT64_MAX;
+        std::atomic<bool> m_InterruptRequested = false;
+
+        ExecutionMode m_ExecutionMode;
+        std::unique_ptr<VM> m_VM;
     };
 
     template <class... Ts>
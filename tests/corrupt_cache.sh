@@ -0,0 +1,73 @@
+#!/bin/bash
+# Damages a compiled .alengc cache one byte at a time, and truncates it at every length, then runs the
+# script each time. A damaged cache must be rejected and the source parsed again; the run may print
+# different results when a damaged literal still reads back, but it must never crash.
+# Usage: tests/corrupt_cache.sh [path/to/AlengCLI]
+
+cd "$(dirname "$0")/.."
+
+CLI=$(realpath "${1:-./build/AlengCLI}")
+
+if [ ! -x "$CLI" ]; then
+  echo "AlengCLI not found at $CLI, build the project first or pass its path."
+  exit 1
+fi
+
+workspace=$(mktemp -d)
+trap 'rm -rf "$workspace"' EXIT
+
+# Covers every node kind the cache stores. No recursion, so a damaged literal cannot overflow the stack.
+cat > "$workspace/main.aleng" <<'EOF'
+Fn add(a, b: Number, $rest)
+    Return a + b
+End
+point = {"x": 1, "y": [2, 3]}
+point.z = not False
+total = 0
+For i = 1 .. 3
+    If i == 2
+        Continue
+    Else
+        total = add(total, i)
+    End
+End
+For key in point
+    total = total + 1
+End
+count = 0
+While count < 2
+    count = count + 1
+    If count != 1
+        Break
+    End
+End
+Print(total, point.y[1], -count, 1.5 * 2)
+EOF
+
+"$CLI" --compile "$workspace" || exit 1
+cache="$workspace/main.alengc"
+pristine="$workspace/pristine"
+cp "$cache" "$pristine"
+size=$(stat -c %s "$pristine")
+
+failures=0
+run() {
+  timeout 10 "$CLI" --step-budget 100000 --memory-limit 10000000 "$workspace" > /dev/null 2>&1
+  local status=$?
+  if [ $status -ge 124 ]; then
+    echo "FAIL ($1): exit status $status"
+    failures=$((failures + 1))
+  fi
+}
+
+for ((offset = 0; offset < size; offset++)); do
+  cp "$pristine" "$cache"
+  printf '\xff' | dd of="$cache" bs=1 seek=$offset conv=notrunc status=none
+  run "byte $offset set to 0xff"
+
+  head -c $offset "$pristine" > "$cache"
+  run "truncated to $offset bytes"
+done
+
+echo "Checked $size damaged and $size truncated caches, $failures failed."
+[ $failures -eq 0 ]
@@ -0,0 +1,371 @@
+// Checks the embedding API that scripts cannot reach, on both engines. Built as AlengEmbeddingTests;
+// exits with 1 if any check fails.
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Core/Error.h"
+#include "Core/GarbageCollector.h"
+#include "Core/ModuleManager.h"
+#include "Core/Parser.h"
+#include "Core/SourceManager.h"
+#include "Core/Visitor.h"
+
+using namespace Aleng;
+
+namespace Aleng
+{
+    void RegisterAllNativeLibraries(ModuleManager &manager);
+}
+
+namespace
+{
+    int g_Passed = 0;
+    int g_Failed = 0;
+
+    void Check(const std::string &name, const bool condition)
+    {
+        if (condition)
+        {
+            g_Passed++;
+            return;
+        }
+        g_Failed++;
+        std::cout << "FAIL: " << name << std::endl;
+    }
+
+    // Runs source and returns the value of its last statement as a number.
+    double Run(Visitor &visitor, const std::string &source)
+    {
+        Parser parser(source, "embedding.aleng");
+        auto program = parser.ParseProgram();
+        if (parser.HasErrors())
+            throw std::runtime_error("Syntax error in test source: " + source);
+        return visitor.Execute(std::move(program)).AsNumber();
+    }
+
+    void TestForkIsolation(const ExecutionMode mode, const std::string &engine)
+    {
+        ModuleManager baseModules(".");
+        Visitor base(baseModules, mode);
+        Run(base, R"(
+            counter = 0
+            items = [1, 2]
+            alias = items
+            config = {"name": "base", "items": items}
+            Fn size(collection)
+                n = 0
+                For element in collection
+                    n = n + 1
+                End
+                Return n
+            End
+            Fn bump()
+                counter = counter + 1
+                Append(items, counter)
+                Return counter
+            End
+            Fn makeCounter()
+                count = 0
+                Fn next()
+                    count = count + 1
+                    Return count
+                End
+                Return next
+            End
+            next = makeCounter()
+            next()
+        )");
+
+        ModuleManager forkModules = baseModules.Fork();
+        const auto fork = base.Fork(forkModules);
+        Check(engine + ": a fork starts with the snapshot's globals", Run(*fork, "size(items) + size(config)") == 4);
+
+        Run(*fork, R"(
+            bump()
+            bump()
+            config.name = "fork"
+            config.extra = True
+            next()
+        )");
+        Check(engine + ": functions from the snapshot update the fork's globals", Run(*fork, "counter") == 2);
+        Check(engine + ": the fork's lists grow", Run(*fork, "size(items)") == 4);
+        Check(engine + ": values shared in the snapshot stay shared in the fork",
+              Run(*fork, "size(alias) + size(config.items)") == 8);
+        Check(engine + ": captured variables are copied", Run(*fork, "next()") == 3);
+
+        Check(engine + ": the snapshot's globals are unchanged", Run(base, "counter") == 0);
+        Check(engine + ": the snapshot's lists are unchanged", Run(base, "size(items) + size(alias)") == 4);
+        Check(engine + ": the snapshot's maps are unchanged", Run(base, "size(config)") == 2);
+        Check(engine + ": the snapshot's captured variables are unchanged", Run(base, "next()") == 2);
+
+        ModuleManager secondModules = baseModules.Fork();
+        const auto second = base.Fork(secondModules);
+        Check(engine + ": forks do not see each other", Run(*second, "bump() + size(items)") == 4);
+
+        // A source module is parsed by the first fork that imports it; the tree keeps the text it
+        // registered, so a later fork that reparsed would register new text.
+        baseModules.RegisterSourceModule("shared", "answer = 42\n");
+        const FileId shared = SourceManager::AddFile("shared");
+        std::shared_ptr<const SourceText> firstParse;
+        for (int run = 0; run < 2; run++)
+        {
+            ModuleManager runModules = baseModules.Fork();
+            const auto runVisitor = base.Fork(runModules);
+            Check(engine + ": a fork imports registered modules", Run(*runVisitor, "Shared = Import \"shared\"\nShared.answer") == 42);
+            if (run == 0)
+                firstParse = SourceManager::GetSource(shared);
+        }
+        Check(engine + ": forks parse a source module once", firstParse && SourceManager::GetSource(shared) == firstParse);
+    }
+
+    // The limit is checked before anything grows, so a script that keeps allocating stops without ever
+    // holding more than it allows.
+    void TestMemoryLimit(const ExecutionMode mode, const std::string &engine)
+    {
+        constexpr size_t limit = 1'000'000;
+        const std::pair<const char *, const char *> growers[] = {
+            {"a list", "xs = []\nWhile True\n    Append(xs, 1, 2, 3)\nEnd\n"},
+            {"a map", "m = {}\ni = 0\nWhile True\n    m[\"k\" + i] = i\n    i = i + 1\nEnd\n"},
+            {"a list literal", "xs = [1]\nWhile True\n    xs = xs + xs\nEnd\n"},
+            {"a string", "s = \"abc\" * 1000000\n"},
+        };
+
+        for (const auto &[name, source] : growers)
+        {
+            ModuleManager modules(".");
+            Visitor visitor(modules, mode);
+            visitor.SetMemoryLimit(limit);
+
+            bool stopped = false;
+            try
+            {
+                Run(visitor, source);
+            } catch (const AlengError &)
+            {
+                stopped = true;
+            }
+            Check(engine + ": growing " + name + " hits the limit", stopped);
+            Check(engine + ": growing " + name + " never goes over the limit", visitor.GetMemoryUsage().Peak <= limit);
+        }
+
+        ModuleManager modules(".");
+        Visitor visitor(modules, mode);
+        const size_t before = visitor.GetMemoryUsage().Current;
+        Run(visitor, "a = 1\nb = 2\nc = 3\nd = 4\n");
+        Check(engine + ": new globals are charged", visitor.GetMemoryUsage().Current > before);
+    }
+
+    // Returns the reason a run stopped, or nothing if it finished.
+    std::optional<ExecutionInterrupted::Reason> RunUntilStopped(Visitor &visitor, const std::string &source)
+    {
+        try
+        {
+            Run(visitor, source);
+        } catch (const ExecutionInterrupted &interrupted)
+        {
+            return interrupted.GetReason();
+        }
+        return std::nullopt;
+    }
+
+    // Loops of every kind, with continue and break, and calls. Both engines must count the same steps.
+    constexpr auto STEP_COUNTING_SOURCE = R"(
+        Fn id(x)
+            Return x
+        End
+        total = 0
+        For i = 1 .. 10
+            If i == 5
+                Continue
+            End
+            total = total + id(i)
+        End
+        For value in [1, 2, 3]
+            total = total + value
+        End
+        For key in {"a": 1, "b": 2}
+            total = total + 1
+        End
+        n = 0
+        While n < 6
+            n = n + 1
+            If n == 2
+                Continue
+            End
+            If n == 5
+                Break
+            End
+        End
+        total
+    )";
+
+    uint64_t TestStepBudget(const ExecutionMode mode, const std::string &engine)
+    {
+        ModuleManager modules(".");
+        Visitor visitor(modules, mode);
+
+        Run(visitor, "For i = 1 .. 10\nEnd\n");
+        Check(engine + ": a numeric For counts only the steps back into its body", visitor.GetStepsTaken() == 9);
+
+        visitor.SetStepBudget(0);
+        Check(engine + ": loops and calls run to completion", Run(visitor, STEP_COUNTING_SOURCE) == 58);
+        const uint64_t steps = visitor.GetStepsTaken();
+
+        visitor.SetStepBudget(1000);
+        Check(engine + ": a runaway loop stops once the budget is used up",
+              RunUntilStopped(visitor, "i = 0\nWhile True\n    i = i + 1\nEnd\n") == ExecutionInterrupted::Reason::STEP_BUDGET_EXHAUSTED);
+        Check(engine + ": the budget is used up exactly", visitor.GetStepsTaken() == 1000);
+        Check(engine + ": later runs stop at their first step",
+              RunUntilStopped(visitor, "Fn f()\n    Return 1\nEnd\nf()\n") == ExecutionInterrupted::Reason::STEP_BUDGET_EXHAUSTED);
+
+        visitor.SetStepBudget(0);
+        Check(engine + ": a new budget lets the interpreter run again", Run(visitor, "f()\n") == 1);
+
+        bool interrupted = false;
+        std::thread host([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            visitor.RequestInterrupt();
+        });
+        interrupted = RunUntilStopped(visitor, "While True\nEnd\n") == ExecutionInterrupted::Reason::INTERRUPT_REQUESTED;
+        host.join();
+        Check(engine + ": RequestInterrupt stops a running script", interrupted);
+        Check(engine + ": an interrupt is cleared once it stopped a run",
+              Run(visitor, "sum = 0\nFor i = 1 .. 3\n    sum = sum + i\nEnd\nsum\n") == 6);
+
+        return steps;
+    }
+
+    void TestCollectionPoints(const ExecutionMode mode, const std::string &engine)
+    {
+        ModuleManager modules(".");
+        RegisterAllNativeLibraries(modules);
+        modules.RegisterSourceModule("cycles", R"(
+            loop = []
+            Append(loop, loop)
+        )");
+        Visitor visitor(modules, mode);
+
+        GarbageCollector::SetThreshold(1);
+        const double collectionsDuringImport = Run(visitor, R"(
+            Gc = Import "std/gc"
+            before = Gc.Stats().Collections
+            Cycles = Import "cycles"
+            Gc.Stats().Collections - before
+        )");
+        GarbageCollector::SetThreshold(GarbageCollector::DEFAULT_THRESHOLD);
+        Check(engine + ": an import does not start a collection", collectionsDuringImport == 0);
+    }
+
+    // Literals that do not fit are syntax errors, reported like any other instead of thrown.
+    void TestLiteralRange()
+    {
+        for (const auto *source : {"x = 99999999999999999999\n", "x = 1000000000000000000000000000000000000000000000.5\n"})
+        {
+            Parser parser(source, "embedding.aleng");
+            parser.ParseProgram();
+            Check(std::string("an out-of-range literal is a syntax error: ") + source, parser.HasErrors());
+        }
+    }
+
+    // The file table only holds source text while a tree or an error still needs it.
+    void TestSourceRelease()
+    {
+        FileId file;
+        std::optional<AlengError> error;
+        {
+            ModuleManager modules(".");
+            Visitor visitor(modules);
+            Parser parser("x = 1\ny = x + [1]\n", "released.aleng");
+            auto program = parser.ParseProgram();
+            file = program->Statements.front()->Location.File;
+            try
+            {
+                visitor.Execute(std::move(program));
+            } catch (const AlengError &err)
+            {
+                error = err;
+            }
+        }
+        Check("an error keeps the source of its file", error && error->GetSource() &&
+              error->GetSource()->GetLine(error->GetRange().Start.Line) == "y = x + [1]");
+        error.reset();
+        Check("the source is released with the last tree and error", !SourceManager::GetSource(file));
+    }
+
+    void TestHeapPerThread()
+    {
+        GarbageCollector::Collect();
+        size_t otherThreadCollections = 1;
+        std::thread([&] { otherThreadCollections = GarbageCollector::GetStats().Collections; }).join();
+        Check("each thread has its own collector", otherThreadCollections == 0);
+    }
+
+    // Maps with the same keys, interned names, imports and collections, all at once on two threads.
+    // Each interpreter is created on the thread that runs it.
+    void TestConcurrentInterpreters()
+    {
+        constexpr auto source = R"(
+            Gc = Import "std/gc"
+            Shapes = Import "shapes"
+            total = 0
+            For i = 1 .. 2000
+                point = Shapes.make(i, "p" + i)
+                loop = [point]
+                Append(loop, loop)
+                total = total + point.x + point.y
+                If i % 500 == 0
+                    Gc.Collect()
+                End
+            End
+            total
+        )";
+
+        double results[2] = {};
+        std::thread threads[2];
+        for (int i = 0; i < 2; i++)
+        {
+            threads[i] = std::thread([&results, i, source] {
+                ModuleManager modules(".");
+                RegisterAllNativeLibraries(modules);
+                modules.RegisterSourceModule("shapes", R"(
+                    Fn make(x, label)
+                        Return {"x": x, "y": x * 2, "label": label}
+                    End
+                )");
+                Visitor visitor(modules, i == 0 ? ExecutionMode::BYTECODE : ExecutionMode::TREE_WALK);
+                results[i] = Run(visitor, source);
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        Check("interpreters on two threads run at the same time", results[0] == 6003000 && results[1] == 6003000);
+    }
+}
+
+int main()
+{
+    std::vector<uint64_t> stepCounts;
+    for (const auto &[mode, engine] : {std::pair{ExecutionMode::BYTECODE, "bytecode"},
+                                       std::pair{ExecutionMode::TREE_WALK, "tree-walk"}})
+    {
+        stepCounts.push_back(TestStepBudget(mode, engine));
+        TestForkIsolation(mode, engine);
+        TestMemoryLimit(mode, engine);
+        TestCollectionPoints(mode, engine);
+    }
+    Check("both engines count the same steps", stepCounts[0] == stepCounts[1]);
+    TestLiteralRange();
+    TestSourceRelease();
+    TestHeapPerThread();
+    TestConcurrentInterpreters();
+
+    std::cout << "Summary: " << g_Passed << " checks passed, " << g_Failed << " failed." << std::endl;
+    return g_Failed == 0 ? 0 : 1;
+}